@@ -24,6 +24,13 @@
 // this example implentation uses putchar from stdio.h 
 // on an embedded system this may be different
 #include <stdio.h> 
+#include "debug_hw_specific.h"
+
+#if defined(EMB_LOG_LOCK_SPIN)
+char emb_log_spin_lock = 0;
+#elif defined(EMB_LOG_LOCK_MUTEX)
+pthread_mutex_t emb_log_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
 
 void DEBUG_init()
 {
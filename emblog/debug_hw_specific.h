@@ -23,9 +23,31 @@
 // -----------------------------------------------------------------------------
 #pragma once
 
-// The user should customize this
-#define EMB_LOG_ENTER_CRITICAL_SECT      // disable interrupts
-#define EMB_LOG_EXIT_CRITICAL_SECT       // enable interrupts
+// The user should customize this. Two implementations for multi-threaded
+// hosts are provided, selected with -DEMB_LOG_LOCK_SPIN / -DEMB_LOG_LOCK_MUTEX
+#if defined(EMB_LOG_LOCK_SPIN)
+ #define EMB_LOG_ENTER_CRITICAL_SECT \
+    while (__atomic_test_and_set(&emb_log_spin_lock, __ATOMIC_ACQUIRE)) {}
+ #define EMB_LOG_EXIT_CRITICAL_SECT \
+    __atomic_clear(&emb_log_spin_lock, __ATOMIC_RELEASE)
+#elif defined(EMB_LOG_LOCK_MUTEX)
+ #include <pthread.h>
+ #define EMB_LOG_ENTER_CRITICAL_SECT pthread_mutex_lock(&emb_log_mutex)
+ #define EMB_LOG_EXIT_CRITICAL_SECT  pthread_mutex_unlock(&emb_log_mutex)
+#else
+ #define EMB_LOG_ENTER_CRITICAL_SECT      // disable interrupts
+ #define EMB_LOG_EXIT_CRITICAL_SECT       // enable interrupts
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(EMB_LOG_LOCK_SPIN)
+extern char emb_log_spin_lock;
+#elif defined(EMB_LOG_LOCK_MUTEX)
+extern pthread_mutex_t emb_log_mutex;
+#endif
 
 void DEBUG_init();
 void DEBUG_wait_for_tx();
@@ -33,3 +55,7 @@ void DEBUG_put_char(char ch);
 int  DEBUG_rx_avail();
 char DEBUG_rx_data();
 char DEBUG_get_char();
+
+#ifdef __cplusplus
+}
+#endif
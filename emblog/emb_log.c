@@ -22,20 +22,18 @@
 // IN THE SOFTWARE.
 // ----------------------------------------------------------------------------
 // This module implements a wrapper over log.c/h event logger
-// The module defines a buffer for events, a log data structure,
-// and to provide times-stamping.
+// The module defines a buffer and a log data structure per channel
+// (see EMB_LOG_CHANNELS in msgs_auto.h), and to provide times-stamping.
 // The code here can be called from interrupt context, as no calls to std c lib
 // are used.
 // ----------------------------------------------------------------------------
 #include "log.h"
 #include "emb_log.h"
-#include "msgs_auto.h"
+#include "emb_log_cfg.h"
 #include "debug.h"
 #include "emb_assert.h"
 #include "debug_hw_specific.h"
 
-uint64_t get_time_stamp();
-
 #if defined(EMB_LOG_XTENSA)
     // Tensilica implementation assumed here (tested a number of years ago, may need updates)
     #include "xtensa_api.h"
@@ -44,7 +42,7 @@ uint64_t get_time_stamp();
     #include <xtensa/hal.h>
     uint64_t get_time_stamp() { return (uint64_t) xthal_get_ccount(); }
     // can be mapped to .text if desired as access is always in multiples of 32-bits
-    static int32_t emb_log_buf[EMB_LOG_ENTRIES] __attribute__((section(".text")));
+    #define EMB_LOG_BUF_ATTR __attribute__((section(".text")))
 #else
     #include <sys/time.h>
     // default is an x86 implementation, for easy testing
@@ -52,43 +50,99 @@ uint64_t get_time_stamp();
     uint64_t get_time_stamp() { 
         return rdtsc();
     }
-    static int32_t emb_log_buf[EMB_LOG_ENTRIES];
+    #define EMB_LOG_BUF_ATTR
+#endif
+
+#ifndef EMB_LOG_FUNC_CHAN
+ #define EMB_LOG_FUNC_CHAN EMB_LOG_CHAN_MAIN // channel for function tracing
 #endif
 
+// one buffer per channel
+#define EMB_LOG_CHAN_BUF(name, entries, one_shot, start_after, stop_after) \
+    static int32_t emb_log_buf_##name[entries] EMB_LOG_BUF_ATTR;
+EMB_LOG_CHANNELS(EMB_LOG_CHAN_BUF)
+
+// static configuration of each channel, in channel index order
+typedef struct {
+    const char *name;
+    int32_t *buf;
+    int entries;
+    int one_shot;
+    int start_after;
+    int stop_after;
+} emb_log_chan_cfg_t;
+
+#define EMB_LOG_CHAN_CFG(name, entries, one_shot, start_after, stop_after) \
+    { #name, emb_log_buf_##name, entries, one_shot, start_after, stop_after },
+static const emb_log_chan_cfg_t emb_log_chan_cfg[EMB_LOG_NUM_CHANS] = {
+    EMB_LOG_CHANNELS(EMB_LOG_CHAN_CFG)
+};
+
+log_t emb_log_chans[EMB_LOG_NUM_CHANS];
 
-static log_t log;
+// per message cost of logging (in time-stamp ticks) by number of arguments
+static uint32_t emb_log_overhead[EMB_LOG_CAL_MAX_ARGS + 1];
 
-// initialize log data structure
+static void emb_log_calibrate();
+
+// initialize log data structures with the settings of each channel
 void emb_log_init()
 {
-    log_init(&log, emb_log_buf, EMB_LOG_ENTRIES);
+    int c;
+    emb_log_calibrate();
+    for (c = 0; c < EMB_LOG_NUM_CHANS; c++) {
+        const emb_log_chan_cfg_t *cfg = &emb_log_chan_cfg[c];
+        log_t *l = &emb_log_chans[c];
+        log_init(l, cfg->buf, cfg->entries);
+        log_set_one_shot(l, cfg->one_shot);
+        if (cfg->start_after >= 0) {
+            log_start_after_cnt_msgs(l, cfg->start_after);
+        }
+        log_stop_after_cnt_capt_msgs(l, cfg->stop_after);
+    }
 }
 
+// The calls below apply to all channels, overriding their settings.
+// Use the log_* calls on &emb_log_chans[EMB_LOG_CHAN_<NAME>] to control
+// a single channel
+
 // enable or disable logging
 void emb_log_set_enable(int on)
 {
-    log_set_enable(&log, on);
+    int c;
+    for (c = 0; c < EMB_LOG_NUM_CHANS; c++) {
+        log_set_enable(&emb_log_chans[c], on);
+    }
 }
 
 // specify an initial number of log messages to skip
 void emb_log_start_after_cnt_msgs(int cnt)
 {
-    log_start_after_cnt_msgs(&log, cnt);
+    int c;
+    for (c = 0; c < EMB_LOG_NUM_CHANS; c++) {
+        log_start_after_cnt_msgs(&emb_log_chans[c], cnt);
+    }
 }
 
 // if val is != 0, we don't wrap around
 void emb_log_set_one_shot(int val) {
-    log_set_one_shot(&log, val);
+    int c;
+    for (c = 0; c < EMB_LOG_NUM_CHANS; c++) {
+        log_set_one_shot(&emb_log_chans[c], val);
+    }
 }
 
 // specify an number of log messages to log
 void emb_log_stop_after_cnt_capt_msgs(int cnt)
 {
-    log_stop_after_cnt_capt_msgs(&log, cnt);
+    int c;
+    for (c = 0; c < EMB_LOG_NUM_CHANS; c++) {
+        log_stop_after_cnt_capt_msgs(&emb_log_chans[c], cnt);
+    }
 }
 
-// add a pre-created log entry
-void emb_log_add(void *msg, int msg_byte_len)
+// add a pre-created log entry to a given channel log
+void emb_log_add_to(log_t *l, void *msg, int msg_byte_len)
 {
     // This restriction could be removed but keeping it makes it
     // compatible with Tensilica logging in .text
@@ -97,11 +151,92 @@ void emb_log_add(void *msg, int msg_byte_len)
     EMB_LOG_ENTER_CRITICAL_SECT; // the following sequence shouldn't be interrupted
 
     uint64_t ts = get_time_stamp();
-    log_add(&log, ts, msg, msg_byte_len);
+    log_add(l, ts, msg, msg_byte_len);
 
     EMB_LOG_EXIT_CRITICAL_SECT;
 }
 
+// add a pre-created log entry to the main channel
+void emb_log_add(void *msg, int msg_byte_len)
+{
+    emb_log_add_to(&emb_log_chans[EMB_LOG_CHAN_MAIN], msg, msg_byte_len);
+}
+
+// Measure the cost of logging a message for each number of arguments by
+// logging bursts of back-to-back messages into a scratch log. The minimum
+// over a few bursts is kept to filter out interrupts. This is what the
+// delta between two consecutive messages is inflated by, the post-processing
+// tools can subtract it
+static void emb_log_calibrate()
+{
+    static int32_t cal_buf[EMB_LOG_CAL_ITERS * (EMB_LOG_CAL_MAX_ARGS + 1)];
+    uint32_t msg[EMB_LOG_CAL_MAX_ARGS + 1] = {0}; // id 0, args 0
+    log_t cal_log;
+    int nargs, rep, i;
+
+    for (nargs = 0; nargs <= EMB_LOG_CAL_MAX_ARGS; nargs++) {
+        int byte_len = (nargs + 1) * sizeof(uint32_t);
+        uint64_t best = ~0ULL;
+        log_init(&cal_log, cal_buf, EMB_LOG_CAL_ITERS * (nargs + 1));
+        for (rep = 0; rep < EMB_LOG_CAL_REPS; rep++) {
+            uint64_t t0 = get_time_stamp();
+            for (i = 0; i < EMB_LOG_CAL_ITERS; i++) {
+                emb_log_add_to(&cal_log, msg, byte_len);
+            }
+            uint64_t t1 = get_time_stamp();
+            if (t1 - t0 < best) {
+                best = t1 - t0;
+            }
+        }
+        emb_log_overhead[nargs] = (uint32_t)(best / EMB_LOG_CAL_ITERS);
+    }
+}
+
+#if defined(EMB_LOG_FUNC_TRACE)
+#if defined(EMB_LOG_NUM_MSGS) && EMB_LOG_NUM_MSGS > EMB_LOG_FUNC_ID
+ #error "no message id left for function tracing, run gen_log.py --func_trace"
+#endif
+
+// Function entry/exit tracing. Code compiled with -finstrument-functions
+// calls the hooks below on every function entry and exit. Each one is logged
+// as the reserved message EMB_LOG_FUNC_ID (flag set on entry, cleared on exit)
+// with the function address compressed into a single word as an offset from
+// emb_log_init(). The host resolves it back using the ELF symbol table
+typedef struct {
+    int32_t fn_ofs;
+    uint32_t id;
+} log_func_t;
+
+static void emb_log_func(void *fn, uint32_t flag_val)
+    __attribute__((no_instrument_function));
+void __cyg_profile_func_enter(void *fn, void *call_site)
+    __attribute__((no_instrument_function));
+void __cyg_profile_func_exit(void *fn, void *call_site)
+    __attribute__((no_instrument_function));
+
+static void emb_log_func(void *fn, uint32_t flag_val)
+{
+    log_t *l = &emb_log_chans[EMB_LOG_FUNC_CHAN];
+    if (!l->buf) { // functions called before emb_log_init() are ignored
+        return;
+    }
+    log_func_t m;
+    m.fn_ofs = (int32_t)((intptr_t)fn - (intptr_t)&emb_log_init);
+    m.id = (flag_val << EMB_LOG_FLAG_VAL_BIT) | EMB_LOG_FUNC_ID;
+    emb_log_add_to(l, &m, sizeof(m));
+}
+
+void __cyg_profile_func_enter(void *fn, void *call_site)
+{
+    emb_log_func(fn, 1);
+}
+
+void __cyg_profile_func_exit(void *fn, void *call_site)
+{
+    emb_log_func(fn, 0);
+}
+#endif
+
 // printing in hex, 8 words per line
 static void entry_dump_raw(int i, int entry, int buf_ofs)
 {
@@ -112,18 +247,53 @@ static void entry_dump_raw(int i, int entry, int buf_ofs)
     DEBUG_putchar(' ');
 }
 
-// dump the buffer into console (not using std lib)
+// dump the buffer of one channel. last_ts (absolute time-stamp of the most
+// recent message) lets the host merge all channels into a single timeline
+static void emb_log_dump_chan(const emb_log_chan_cfg_t *cfg, log_t *l)
+{
+    DEBUG_print("\nchannel=");     DEBUG_print(cfg->name);
+    DEBUG_print("\ncursor=");      DEBUG_print_dec(l->cur);
+    DEBUG_print("\nwrapped=");     DEBUG_print_dec(l->wrapped);
+    DEBUG_print("\nenabled=");     DEBUG_print_dec(l->enabled);
+    DEBUG_print("\nevnt_cnt=");    DEBUG_print_dec(l->cnt);
+    DEBUG_print("\nmax_entries="); DEBUG_print_dec(l->max_entries);
+    DEBUG_print("\nlast_ts=");     DEBUG_print_hex((uint32_t)(l->last_ts >> 32));
+                                   DEBUG_print_hex((uint32_t)l->last_ts);
+    DEBUG_print("\nfirst_ts=");    DEBUG_print_hex((uint32_t)(l->first_ts >> 32));
+                                   DEBUG_print_hex((uint32_t)l->first_ts);
+    DEBUG_print("\ncaptured=");    DEBUG_print_dec(l->captured);
+    DEBUG_print("\ndrop_disabled=");  DEBUG_print_dec(l->drop_disabled);
+    DEBUG_print("\ndrop_pre_start="); DEBUG_print_dec(l->drop_pre_start);
+    DEBUG_print("\ndrop_stopped=");   DEBUG_print_dec(l->drop_stopped);
+    DEBUG_print("\ndrop_one_shot=");  DEBUG_print_dec(l->drop_one_shot);
+    DEBUG_print("\nwords=");       DEBUG_print_dec(l->words);
+    DEBUG_print("\npeak_win_words="); DEBUG_print_dec(l->peak_win_words);
+    DEBUG_print("\n=== Start buffer dump. Most recent first ===");
+    log_dump_raw(l, entry_dump_raw);
+    DEBUG_println("\n=== End buffer dump ===");
+}
+
+// dump the buffers of all channels into console (not using std lib)
 void emb_log_dump(int format)
 {
+    int i;
     if (0 == format) {
-        DEBUG_print("\ncursor=");      DEBUG_print_dec(log.cur);
-        DEBUG_print("\nwrapped=");     DEBUG_print_dec(log.wrapped);
-        DEBUG_print("\nenabled=");     DEBUG_print_dec(log.enabled);
-        DEBUG_print("\nevnt_cnt=");    DEBUG_print_dec(log.cnt);
-        DEBUG_print("\nmax_entries="); DEBUG_print_dec(log.max_entries);
-        DEBUG_print("\n=== Start buffer dump. Most recent first ===");
-        log_dump_raw(&log, entry_dump_raw);
-        DEBUG_println("\n=== End buffer dump ===");
+        DEBUG_print("\nid_bits=");     DEBUG_print_dec(EMB_LOG_ID_BITS);
+        DEBUG_print("\nts_prescale="); DEBUG_print_dec(EMB_LOG_TS_PRESCALE);
+#if defined(EMB_LOG_FUNC_TRACE)
+        DEBUG_print("\nfunc_trace=1");
+#else
+        DEBUG_print("\nfunc_trace=0");
+#endif
+        DEBUG_print("\nrate_window="); // as used, in (unscaled) ticks
+        DEBUG_print_dec((uint32_t)(EMB_LOG_RATE_WINDOW_TS << EMB_LOG_TS_PRESCALE));
+        DEBUG_print("\noverhead_ticks="); DEBUG_print_dec(emb_log_overhead[0]);
+        for (i = 1; i <= EMB_LOG_CAL_MAX_ARGS; i++) {
+            DEBUG_putchar(',');        DEBUG_print_dec(emb_log_overhead[i]);
+        }
+        for (i = 0; i < EMB_LOG_NUM_CHANS; i++) {
+            emb_log_dump_chan(&emb_log_chan_cfg[i], &emb_log_chans[i]);
+        }
     }
     else {
         // just a place holder for other possible formats
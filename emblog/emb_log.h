@@ -23,12 +23,38 @@
 // -----------------------------------------------------------------------------
 #pragma once
 
+#include "log.h"
+
 #ifndef EMB_LOG_ENTRIES
  // each entry is 4 B. Different messages may use different number of entries
  // depending on arguments and size of relative time-stamp (1 being minimum)
  #define EMB_LOG_ENTRIES 256   // 1KB
 #endif
 
+#ifndef EMB_LOG_CAL_MAX_ARGS
+ // emb_log_init() measures the per message logging overhead for messages of
+ // 0..EMB_LOG_CAL_MAX_ARGS arguments, reported in the dump header
+ #define EMB_LOG_CAL_MAX_ARGS 4
+#endif
+
+#ifndef EMB_LOG_CAL_ITERS
+ // messages logged per calibration burst
+ #define EMB_LOG_CAL_ITERS 32
+#endif
+
+#ifndef EMB_LOG_CAL_REPS
+ // calibration bursts per message size, the fastest one is kept
+ #define EMB_LOG_CAL_REPS 16
+#endif
+
+// One log per channel declared in msgs.txt, indexed by EMB_LOG_CHAN_<NAME>
+// (msgs_auto.h). Channel 0 (main) is always present
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern log_t emb_log_chans[];
+
 // Required call before usage to initialize internal data structures
 void emb_log_init();
 
@@ -42,9 +68,22 @@ void emb_log_start_after_cnt_msgs(int cnt);
 // have been logged
 void emb_log_stop_after_cnt_capt_msgs(int cnt);
 
+// if val is != 0, log doesn't wrap around
+void emb_log_set_one_shot(int val);
+
 // Dump current log
 void emb_log_dump(int format);
 
-// add an entry to the log. Usually io
+// add an entry to the main channel log
 void emb_log_add(void *msg, int msg_byte_len);
 
+// add an entry to a given channel log. Used by the macros in msgs_auto.h
+void emb_log_add_to(log_t *log, void *msg, int msg_byte_len);
+
+// current time-stamp (platform specific, see emb_log.c)
+uint64_t get_time_stamp();
+
+#ifdef __cplusplus
+}
+#endif
+
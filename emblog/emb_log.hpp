@@ -0,0 +1,332 @@
+// -----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright 2022-Present Miguel A. Guerrero
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal # in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+// -----------------------------------------------------------------------------
+// C++17 header-only front end of emb_log, an alternative to the macros that
+// gen_log.py generates from msgs.txt. Messages are declared in code:
+//
+//   inline constexpr emb_log::message<> some_event{
+//       "some_event", emb_log::kind::event, 1, {}};
+//   inline constexpr emb_log::message<uint32_t> msg1{
+//       "msg1", emb_log::kind::flag, 0, {"a"}};
+//   inline constexpr emb_log::message<const char *, float> state{
+//       "state", emb_log::kind::event, 1, {"name", "load"}, "%s at %.2f"};
+//
+//   using app_log = emb_log::registry<some_event, msg1>;
+//   EMB_LOG_REGISTRY(app_log); // message table for the host (any TU)
+//
+//   app_log::event<some_event>();
+//   app_log::flag<msg1>(1, 111);
+//
+// The id of a message is its position in the registry. The id, number of
+// words and id word encoding are all resolved at compile time, arguments
+// must fit the declared types without narrowing (int literals are fine for
+// u32, 0.5 needs 0.5f for f32) and are written straight into the ring
+// (no intermediate struct), and messages above EMB_LOG_DBG_LVL (or all of
+// them with EMB_LOG_DISABLED) compile to nothing.
+//
+// EMB_LOG_REGISTRY places one msgs.txt-like line per message in the ELF
+// section .emb_log_msgs, which gen_log.py --msgs_from_elf reads instead of
+// msgs.txt. It is needed in at least one translation unit and can be in
+// several (e.g. in a header next to the registry), gen_log.py merges the
+// copies and rejects ids registered differently. All messages go to the
+// main channel
+// -----------------------------------------------------------------------------
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <type_traits>
+#include <utility>
+#include "emb_log_cfg.h"
+#include "emb_log.h"
+#include "debug_hw_specific.h"
+
+namespace emb_log {
+
+enum class kind { event, flag };
+
+// message descriptor, Args are the argument types
+template <typename... Args>
+struct message {
+    const char *name;
+    kind k;
+    int level;
+    const char *arg_names[sizeof...(Args) + 1]; // +1 as it can't be empty
+    const char *fmt = nullptr; // printf-style template applied by the host
+};
+
+// how each argument type is named in msgs.txt and stored in the ring
+template <typename T> struct arg_traits;
+
+template <> struct arg_traits<uint32_t> {
+    static constexpr const char *type_name = "u32";
+    static void emit(log_t *l, uint32_t v) { log_emit_word(l, (int32_t)v); }
+};
+
+// constant strings only (e.g. literals), as just the address is logged
+template <> struct arg_traits<const char *> {
+    static constexpr const char *type_name = "str";
+    static void emit(log_t *l, const char *v)
+    {
+        log_emit_word(l, (int32_t)((intptr_t)v - (intptr_t)&emb_log_init));
+    }
+};
+
+template <> struct arg_traits<float> {
+    static constexpr const char *type_name = "f32";
+    static void emit(log_t *l, float v)
+    {
+        int32_t w;
+        memcpy(&w, &v, sizeof(w));
+        log_emit_word(l, w);
+    }
+};
+
+// low word first, so the dump shows the high one first
+template <> struct arg_traits<double> {
+    static constexpr const char *type_name = "f64";
+    static void emit(log_t *l, double v)
+    {
+        uint64_t u;
+        memcpy(&u, &v, sizeof(u));
+        log_emit_word(l, (int32_t)u);
+        log_emit_word(l, (int32_t)(u >> 32));
+    }
+};
+
+// entry of the message table, one per message
+constexpr size_t MSG_LINE_LEN = 252;
+
+struct msg_record {
+    uint32_t id;
+    char line[MSG_LINE_LEN]; // as in msgs.txt, e.g. "level:0 msg1:flag a:u32"
+                             // fmt must not contain double quotes
+};
+
+namespace detail {
+
+template <typename T> struct identity { using type = T; };
+
+// T converts to Arg without narrowing (brace init rejects narrowing)
+template <typename Arg, typename T, typename = void>
+struct converts_exactly : std::false_type {};
+
+template <typename Arg, typename T>
+struct converts_exactly<Arg, T, std::void_t<decltype(Arg{std::declval<T>()})>>
+    : std::true_type {};
+
+// a T argument can be logged as Arg if no value is lost. u32 also takes
+// signed integers up to 32 bits (int literals), logged as their bits
+template <typename Arg, typename T>
+struct accepts : converts_exactly<Arg, T> {};
+
+template <typename T>
+struct accepts<uint32_t, T>
+    : std::bool_constant<converts_exactly<uint32_t, T>::value ||
+                         (std::is_integral<T>::value &&
+                          sizeof(T) <= sizeof(uint32_t))> {};
+
+template <typename... T> struct type_list {};
+
+template <typename... Args, typename... T>
+constexpr bool args_accepted(const message<Args...> &, type_list<T...>)
+{
+    if constexpr (sizeof...(Args) != sizeof...(T)) {
+        return false;
+    } else {
+        return (accepts<Args, T>::value && ...);
+    }
+}
+
+template <typename... Args>
+constexpr size_t num_args(const message<Args...> &)
+{
+    return sizeof...(Args);
+}
+
+constexpr void append(char *line, size_t &pos, const char *s)
+{
+    while (*s) {
+        line[pos++] = *s++; // overflowing MSG_LINE_LEN fails to compile
+    }
+}
+
+constexpr void append_int(char *line, size_t &pos, int v)
+{
+    char digits[12] = {};
+    int n = 0;
+    if (v < 0) {
+        line[pos++] = '-';
+        v = -v;
+    }
+    do {
+        digits[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    while (n) {
+        line[pos++] = digits[--n];
+    }
+}
+
+template <typename... Args>
+constexpr msg_record make_record(const message<Args...> &m, uint32_t id)
+{
+    const char *types[] = { arg_traits<Args>::type_name..., nullptr };
+    msg_record r = {};
+    size_t pos = 0;
+    r.id = id;
+    append(r.line, pos, "level:");
+    append_int(r.line, pos, m.level);
+    append(r.line, pos, " ");
+    append(r.line, pos, m.name);
+    append(r.line, pos, m.k == kind::flag ? ":flag" : ":event");
+    for (size_t i = 0; i < sizeof...(Args); i++) {
+        append(r.line, pos, " ");
+        append(r.line, pos, m.arg_names[i]);
+        append(r.line, pos, ":");
+        append(r.line, pos, types[i]);
+    }
+    if (m.fmt) {
+        append(r.line, pos, " fmt:\"");
+        append(r.line, pos, m.fmt);
+        append(r.line, pos, "\"");
+    }
+    return r;
+}
+
+// arguments are emitted last to first, so they come out of the (most recent
+// first) dump in declaration order
+inline void emit_args(log_t *) {}
+
+template <typename T, typename... Rest>
+inline void emit_args(log_t *l, T first, Rest... rest)
+{
+    emit_args(l, rest...);
+    arg_traits<T>::emit(l, first);
+}
+
+template <typename... Args>
+inline void write(log_t *l, uint32_t id, const message<Args...> &,
+                  typename identity<Args>::type... args)
+{
+    EMB_LOG_ENTER_CRITICAL_SECT; // the following sequence shouldn't be interrupted
+
+    uint64_t ts = get_time_stamp();
+    if (log_begin(l)) {
+        emit_args(l, args...);
+        log_end(l, ts, id);
+    }
+
+    EMB_LOG_EXIT_CRITICAL_SECT;
+}
+
+} // namespace detail
+
+// set of messages of the application. Each message id is its position
+template <const auto &... Msgs>
+struct registry {
+    static constexpr size_t size = sizeof...(Msgs);
+#if defined(EMB_LOG_FUNC_TRACE)
+    static_assert(size <= EMB_LOG_FUNC_ID, // last id for function tracing
+                  "too many messages for EMB_LOG_ID_BITS");
+#else
+    static_assert(size <= EMB_LOG_FUNC_ID + 1,
+                  "too many messages for EMB_LOG_ID_BITS");
+#endif
+
+    template <const auto &M>
+    static constexpr uint32_t id_of()
+    {
+        const void *addrs[] = { &Msgs... };
+        uint32_t i = 0;
+        while (i < size && addrs[i] != (const void *)&M) {
+            i++;
+        }
+        return i;
+    }
+
+    template <const auto &M>
+    static constexpr bool enabled()
+    {
+#if defined(EMB_LOG_DISABLED)
+        return false;
+#else
+        return M.level <= EMB_LOG_DBG_LVL;
+#endif
+    }
+
+    template <const auto &M, typename... T>
+    static inline void event(T... args)
+    {
+        static_assert(id_of<M>() < size, "message not in registry");
+        static_assert(M.k == kind::event, "use flag<>() for flag messages");
+        static_assert(detail::num_args(M) == sizeof...(T),
+                      "wrong number of arguments for the message");
+        static_assert(detail::args_accepted(M, detail::type_list<T...>()),
+                      "argument doesn't fit the declared type (narrowing)");
+        if constexpr (enabled<M>()) {
+            detail::write(&emb_log_chans[EMB_LOG_CHAN_MAIN], id_of<M>(), M,
+                          args...);
+        }
+    }
+
+    template <const auto &M, typename... T>
+    static inline void flag(uint32_t flag_val, T... args)
+    {
+        static_assert(id_of<M>() < size, "message not in registry");
+        static_assert(M.k == kind::flag, "use event<>() for event messages");
+        static_assert(detail::num_args(M) == sizeof...(T),
+                      "wrong number of arguments for the message");
+        static_assert(detail::args_accepted(M, detail::type_list<T...>()),
+                      "argument doesn't fit the declared type (narrowing)");
+        if constexpr (enabled<M>()) {
+            uint32_t id = ((flag_val & 1) << EMB_LOG_FLAG_VAL_BIT) | id_of<M>();
+            detail::write(&emb_log_chans[EMB_LOG_CHAN_MAIN], id, M, args...);
+        }
+    }
+
+    // message table, in id order
+    struct table_t {
+        msg_record rec[size];
+    };
+
+    static constexpr table_t table()
+    {
+        return make_table(std::make_index_sequence<size>());
+    }
+
+private:
+    template <size_t... I>
+    static constexpr table_t make_table(std::index_sequence<I...>)
+    {
+        return table_t { { detail::make_record(Msgs, I)... } };
+    }
+};
+
+} // namespace emb_log
+
+// place the message table of a registry in the ELF file, for the host tools
+#define EMB_LOG_REGISTRY(reg) \
+    [[gnu::used, gnu::section(".emb_log_msgs")]] \
+    static constexpr typename reg::table_t emb_log_msgs_table_ = reg::table()
@@ -0,0 +1,69 @@
+// -----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright 2022-Present Miguel A. Guerrero
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal # in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+// -----------------------------------------------------------------------------
+// Encoding and channel settings shared by the library and its users.
+// They normally come from the msgs_auto.h generated by gen_log.py. Code
+// not using gen_log.py (e.g. the C++ API of emb_log.hpp) can build with
+// -DEMB_LOG_NO_MSGS_AUTO and get the defaults below instead, overriding
+// any of them with -D
+// -----------------------------------------------------------------------------
+#pragma once
+
+#include <stdint.h>
+
+#ifndef EMB_LOG_NO_MSGS_AUTO
+ #include "msgs_auto.h"
+#else
+
+#ifndef EMB_LOG_DBG_LVL
+ #define EMB_LOG_DBG_LVL 1
+#endif
+
+#ifndef EMB_LOG_ID_BITS
+ #define EMB_LOG_ID_BITS 6
+#endif
+
+#ifndef EMB_LOG_TS_PRESCALE
+ #define EMB_LOG_TS_PRESCALE 0
+#endif
+
+#if EMB_LOG_TS_PRESCALE < 0 || EMB_LOG_TS_PRESCALE > 31
+ #error "EMB_LOG_TS_PRESCALE must be in 0..31"
+#endif
+
+// | TS[31:ID_BITS+2] | TS64 | FLAG_VAL | ID[ID_BITS-1:0] | (see gen_log.py)
+#define EMB_LOG_TS_SHIFT     (EMB_LOG_ID_BITS + 2)
+#define EMB_LOG_TS64_BIT     (EMB_LOG_ID_BITS + 1)
+#define EMB_LOG_TS64_MASK    (1 << EMB_LOG_TS64_BIT)
+#define EMB_LOG_FLAG_VAL_BIT EMB_LOG_ID_BITS
+#define EMB_LOG_TS_MAX       ((1u << (32 - EMB_LOG_TS_SHIFT)) - 1)
+#define EMB_LOG_FUNC_ID      ((1u << EMB_LOG_ID_BITS) - 1)
+
+// a single channel: X(name, entries, one_shot, start_after, stop_after)
+#ifndef EMB_LOG_CHANNELS
+ #define EMB_LOG_CHANNELS(X) X(main, EMB_LOG_ENTRIES, 0, -1, -1)
+ #define EMB_LOG_CHAN_MAIN 0
+ #define EMB_LOG_NUM_CHANS 1
+#endif
+
+#endif
@@ -28,7 +28,7 @@
 // msgs or have any other dependency on project or underlaying hardware
 // ----------------------------------------------------------------------------
 #include "log.h"
-#include "msgs_auto.h" // for EMB_LOG_TS_SHIFT/EMB_LOG_TS_MAX
+#include "emb_log_cfg.h" // for EMB_LOG_TS_SHIFT/EMB_LOG_TS_MAX/EMB_LOG_TS_PRESCALE
 
 #define HI_WORD_MASK 0xFFFFFFFF00000000ULL
 #define LO_WORD_MASK 0x00000000FFFFFFFFULL
@@ -47,6 +47,17 @@ void log_init(log_t* log, int32_t* bufin, int bufin_nwords)
     log->enabled = 1;
     log->first = 1;
     log->one_shot = 0;
+    log->captured = 0;
+    log->drop_disabled = 0;
+    log->drop_pre_start = 0;
+    log->drop_stopped = 0;
+    log->drop_one_shot = 0;
+    log->words = 0;
+    log->first_ts = 0;
+    log->win_start_ts = 0;
+    log->win_start_words = 0;
+    log->msg_start_words = 0;
+    log->peak_win_words = 0;
 }
 
 void log_set_enable(log_t* log, int on)
@@ -70,18 +81,10 @@ void log_set_one_shot(log_t* log, int val) {
     log->one_shot = val;
 }
 
-// This code attempts to be constant time (avoid conditionals)
-#define EMIT_WORD(w) do {\
-        log->buf[log->cur++] = (w); \
-        int in_range = log->cur < log->max_entries; \
-        log->cur *= in_range; /* zero-out if out of range */ \
-        log->wrapped |= !in_range; \
-    } while(0)
-
-
-// Add an entry to the log specificying bufer and length in bytes
-// the orignal buffer is expected to be word aligned
-void log_add(log_t* log, uint64_t tsin, void *msgin, int byte_len_in)
+// Update counters and start/stop triggers for a new message. Returns
+// non zero if the message is to be captured, in which case its argument
+// words are to be emitted with log_emit_word() followed by log_end()
+int log_begin(log_t* log)
 {
     // Update total message count pushed
     log->cnt++;
@@ -94,25 +97,40 @@ void log_add(log_t* log, uint64_t tsin, void *msgin, int byte_len_in)
         log->start_cnt--;
     }
 
-    // exit if temporarily disabled capture
-    if (!log->enabled || (log->one_shot && log->wrapped)) {
-        return;
+    // exit if temporarily disabled capture, accounting for the reason
+    if (!log->enabled) {
+        if (log->start_cnt >= 0)
+            log->drop_pre_start++;
+        else if (log->stop_cnt == 0)
+            log->drop_stopped++;
+        else
+            log->drop_disabled++;
+        return 0;
+    }
+    if (log->one_shot && log->wrapped) {
+        log->drop_one_shot++;
+        return 0;
     }
 
+    log->captured++;
+    log->msg_start_words = log->words;
+    return 1;
+}
+
+// Complete a message started with log_begin(): emit its time-stamp
+// (relative to the previous one) and the id word carrying it
+void log_end(log_t* log, uint64_t tsin, uint32_t id)
+{
+    // time-stamps are kept in prescaled units (see gen_log.py --ts_prescale)
+    tsin >>= EMB_LOG_TS_PRESCALE;
+
     if (log->first) {
         log->last_ts = tsin;
+        log->first_ts = tsin;
+        log->win_start_ts = tsin;
         log->first = 0;
     }
 
-    // Push message to circular queue as words
-    int32_t *msg = (int32_t *) msgin;
-    int word_len = (byte_len_in + 3) / 4;  // len is padded to word boundary
-
-    int i;
-    for (i=0; i < word_len - 1; i++) { // all but last
-        EMIT_WORD(msg[i]);
-    }
-
     // insert time-stamp as relative to prev event
     uint64_t ts = tsin - log->last_ts;
     log->last_ts = tsin;
@@ -120,18 +138,30 @@ void log_add(log_t* log, uint64_t tsin, void *msgin, int byte_len_in)
     uint32_t flag_ts_is_64b = 0;
     // this happens very rarelly
     if ((ts & HI_WORD_MASK) != 0) { // if bigger than 32 bits
-        EMIT_WORD((ts >> 32) & LO_WORD_MASK);
-        EMIT_WORD(ts & LO_WORD_MASK);
+        log_emit_word(log, (ts >> 32) & LO_WORD_MASK);
+        log_emit_word(log, ts & LO_WORD_MASK);
         flag_ts_is_64b = EMB_LOG_TS64_MASK; // indicate it is a 64 bit time-stamp
         ts = EMB_LOG_TS_MAX; // and flag ts as maxed out
     }
     else if (ts >= EMB_LOG_TS_MAX) {
         // if ts is bigger than what fits on msg id word, add extra word
-        EMIT_WORD(ts & LO_WORD_MASK);
+        log_emit_word(log, ts & LO_WORD_MASK);
         ts = EMB_LOG_TS_MAX; // and flag ts as maxed out
     }
     // last has id and embedded ts
-    EMIT_WORD(msg[i] | flag_ts_is_64b | (ts << EMB_LOG_TS_SHIFT));
+    log_emit_word(log, id | flag_ts_is_64b | (ts << EMB_LOG_TS_SHIFT));
+
+    // high-water mark of the words written per EMB_LOG_RATE_WINDOW ticks
+    // (back to back windows, the first message of one starting it, so
+    // roll the window before counting this message in)
+    if (tsin - log->win_start_ts >= EMB_LOG_RATE_WINDOW_TS) {
+        log->win_start_ts = tsin;
+        log->win_start_words = log->msg_start_words;
+    }
+    uint32_t win_words = log->words - log->win_start_words;
+    if (win_words > log->peak_win_words) {
+        log->peak_win_words = win_words;
+    }
 
     // check whether there is a delayed log disable
     if (log->stop_cnt >= 0 && log->enabled) {
@@ -143,6 +173,26 @@ void log_add(log_t* log, uint64_t tsin, void *msgin, int byte_len_in)
     }
 }
 
+// Add an entry to the log specificying bufer and length in bytes
+// the orignal buffer is expected to be word aligned
+void log_add(log_t* log, uint64_t tsin, void *msgin, int byte_len_in)
+{
+    if (!log_begin(log)) {
+        return;
+    }
+
+    // Push message to circular queue as words
+    int32_t *msg = (int32_t *) msgin;
+    int word_len = (byte_len_in + 3) / 4;  // len is padded to word boundary
+
+    int i;
+    for (i=0; i < word_len - 1; i++) { // all but last
+        log_emit_word(log, msg[i]);
+    }
+
+    log_end(log, tsin, msg[i]);
+}
+
 // Circular buffer dump happens most-recent first. The dump function
 // is user provided. If the messages are defined so that the message
 // type is at the end of it, it sould be parseable regardless of
@@ -27,29 +27,77 @@
 # define EMB_LOG_ONE_SHOT 0   // if 1 disallow circular wrap
 #endif
 
+#ifndef EMB_LOG_RATE_WINDOW
+# define EMB_LOG_RATE_WINDOW (1 << 20) // ticks per window of the peak rate
+#endif
+
+// the window in prescaled ticks (EMB_LOG_TS_PRESCALE, from emb_log_cfg.h),
+// at least one
+#define EMB_LOG_RATE_WINDOW_TS \
+    ((((uint64_t)EMB_LOG_RATE_WINDOW) >> EMB_LOG_TS_PRESCALE) ? \
+     (((uint64_t)EMB_LOG_RATE_WINDOW) >> EMB_LOG_TS_PRESCALE) : 1)
+
+#ifndef EMB_LOG_CACHE_LINE
+# define EMB_LOG_CACHE_LINE 64 // log_t alignment (and size granularity)
+#endif
+
 #include <stdint.h>
 
 typedef void (*dump_f)(int i, int entry, int buf_ofs);
 
 // data structure that keeps track of where we are in the trace
-// buffer and other control info
+// buffer and other control info. Cache line aligned so that the channels
+// in an array of them (emb_log_chans) written by different cpus don't
+// share lines
 typedef struct {
     int32_t *buf;     // Assuming word aligned
     int max_entries;  // Max space in words in log buffer
     int cur;          // Place to enter next message
-    int cnt;          // Total messages captured so far
+    int cnt;          // Total messages attempted to log so far
     int start_cnt;    // Msgs till starting log, <=0 to ignore
     int stop_cnt;     // Msgs till stopping log, <=0 to ignore
-    uint64_t last_ts; // Last seen time-stamp
+    uint64_t last_ts; // Last seen time-stamp (prescaled)
     int wrapped;      // Did the buffer ever wrapped around
     int enabled;      // If non zero, we record log events
     int first;        // True for 1st event only
     int one_shot;     // If set, we won't wrap around, just stop
                       // logging
-} log_t;
+    // loss accounting, cnt = captured + drop_*
+    int captured;              // Messages written into the buffer
+    int drop_disabled;         // Messages dropped as logging was disabled
+    int drop_pre_start;        // ... before start_cnt expired
+    int drop_stopped;          // ... after stop_cnt expired
+    int drop_one_shot;         // ... as the one_shot buffer was full
+    uint32_t words;            // Words written, beyond max_entries overwritten
+    uint64_t first_ts;         // First time-stamp captured (prescaled)
+    uint64_t win_start_ts;     // Start of the current rate window (prescaled)
+    uint32_t win_start_words;  // words when it started
+    uint32_t msg_start_words;  // words when the current message started
+    uint32_t peak_win_words;   // Max words written in a rate window
+} __attribute__((aligned(EMB_LOG_CACHE_LINE))) log_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 void log_init(log_t* log, int32_t* bufin, int bufin_nwords);
 void log_add(log_t* log, uint64_t ts, void *msgin, int byte_len_in);
+
+// log_add() split in steps, to emit argument words without building the
+// message in memory first: if (log_begin()) { log_emit_word()...; log_end() }
+int  log_begin(log_t* log);
+void log_end(log_t* log, uint64_t ts, uint32_t id);
+
+// This code attempts to be constant time (avoid conditionals)
+static inline void log_emit_word(log_t* log, int32_t w)
+{
+    log->words++;
+    log->buf[log->cur++] = w;
+    int in_range = log->cur < log->max_entries;
+    log->cur *= in_range; /* zero-out if out of range */
+    log->wrapped |= !in_range;
+}
+
 void log_dump_raw(log_t *log, dump_f dump_func);
 void log_set_one_shot(log_t* log, int val);
 
@@ -57,3 +105,6 @@ void log_set_enable(log_t* log, int on);
 void log_start_after_cnt_msgs(log_t* log, int cnt);
 void log_stop_after_cnt_capt_msgs(log_t* log, int cnt);
 
+#ifdef __cplusplus
+}
+#endif
@@ -15,6 +15,7 @@ void long_comp()
     EMB_LOG_LONG_COMP_BODY(1);
     for (i=0; i<1000000ULL; i++) {}
     EMB_LOG_LONG_COMP_BODY(0);
+    EMB_LOG_COMP_DONE("long_comp", 0.5f, i / 3.0);
 }
 
 
@@ -0,0 +1,72 @@
+//--------------------------------------------------------------------------
+// Example of use of the C++ API (emb_log.hpp). Same as example/main.c but
+// with the messages declared in code rather than in msgs.txt
+//--------------------------------------------------------------------------
+#include "emb_log.hpp"
+
+using emb_log::kind;
+using emb_log::message;
+
+inline constexpr message<> some_event_msg{"some_event", kind::event, 1, {}};
+inline constexpr message<> long_comp_body{"long_comp_body", kind::flag, 1, {}};
+inline constexpr message<> iter_start{"iter_start", kind::event, 1, {}};
+inline constexpr message<> iter_stop{"iter_stop", kind::event, 1, {}};
+inline constexpr message<uint32_t> msg1{"msg1", kind::flag, 0, {"a"}};
+inline constexpr message<uint32_t> msg2{"msg2", kind::flag, 1, {"b"}};
+inline constexpr message<uint32_t> msg3{"msg3", kind::flag, 2, {"c"}};
+inline constexpr message<const char *, float, double> comp_done{
+    "comp_done", kind::event, 1, {"phase", "ratio", "avg"},
+    "%s done, ratio %.2f, avg %.4f"};
+
+using app_log = emb_log::registry<
+    some_event_msg, long_comp_body, iter_start, iter_stop, msg1, msg2, msg3,
+    comp_done>;
+EMB_LOG_REGISTRY(app_log);
+
+void some_event()
+{
+    app_log::event<some_event_msg>();
+}
+
+void long_comp()
+{
+    unsigned long long i;
+    app_log::flag<long_comp_body>(1);
+    for (i=0; i<1000000ULL; i++) {}
+    app_log::flag<long_comp_body>(0);
+    app_log::event<comp_done>("long_comp", 0.5f, i / 3.0);
+}
+
+
+void misc()
+{
+    app_log::flag<msg1>(1, 111);
+    app_log::flag<msg2>(1, 221);
+    app_log::flag<msg3>(1, 331); // level 2, compiled out
+    // ...
+    app_log::flag<msg3>(0, 330);
+    app_log::flag<msg2>(0, 220);
+    app_log::flag<msg1>(0, 110);
+}
+
+int main() 
+{
+    int i;
+
+    emb_log_init();
+    emb_log_set_enable(1);
+
+    for (i=100; i; i--)
+    {
+        app_log::event<iter_start>(); // this is just an event to signal start of iteration
+
+        some_event();
+        long_comp();
+        misc();
+
+        app_log::event<iter_stop>(); // event to indicate end of the iteration
+    }
+    emb_log_dump(0);
+
+    return 0;
+}
@@ -0,0 +1,158 @@
+# -----------------------------------------------------------------------------
+# MIT License
+#
+# Copyright 2022-Present Miguel A. Guerrero
+#
+# Permission is hereby granted, free of charge, to any person obtaining a
+# copy of this software and associated documentation files (the "Software"),
+# to deal # in the Software without restriction, including without limitation
+# the rights to use, copy, modify, merge, publish, distribute, sublicense,
+# and/or sell copies of the Software, and to permit persons to whom the
+# Software is furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included
+# in all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+# THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+# IN THE SOFTWARE.
+# -----------------------------------------------------------------------------
+# Minimal ELF reader used by gen_log.py to symbolize addresses and read strings
+# found in the trace. It reads the section headers and the symbol table
+# directly (32/64 bit, little/big endian) so no external tools (nm,
+# addr2line...) are needed
+# -----------------------------------------------------------------------------
+import bisect
+import struct
+
+SHT_SYMTAB = 2
+SHT_NOBITS = 8
+SHT_DYNSYM = 11
+SHF_ALLOC = 2
+STT_FUNC = 2
+
+
+class ElfFile:
+    def __init__(self, filename):
+        with open(filename, "rb") as fin:
+            self.data = fin.read()
+
+        if self.data[:4] != b"\x7fELF":
+            raise ValueError(f"{filename} is not an ELF file")
+
+        self.is_64 = self.data[4] == 2
+        self.endian = "<" if self.data[5] == 1 else ">"
+        self.sections = self._read_sections()
+        self.funcs = []  # (addr, size, name) sorted by address
+        self.symbols = dict()  # name -> addr, any symbol type
+        self._read_symbols()
+        self.func_addrs = [f[0] for f in self.funcs]
+
+    def _unpack(self, fmt, ofs):
+        return struct.unpack_from(self.endian + fmt, self.data, ofs)
+
+    def _read_sections(self):
+        if self.is_64:
+            shoff, = self._unpack("Q", 0x28)
+            shentsize, shnum, shstrndx = self._unpack("HHH", 0x3A)
+            shfmt = "IIQQQQIIQQ"
+        else:
+            shoff, = self._unpack("I", 0x20)
+            shentsize, shnum, shstrndx = self._unpack("HHH", 0x2E)
+            shfmt = "IIIIIIIIII"
+
+        raw = []
+        for k in range(shnum):
+            (name, typ, flags, addr, offset, size, link, info, _, entsize) = (
+                self._unpack(shfmt, shoff + k * shentsize)
+            )
+            raw.append(
+                dict(
+                    name_ofs=name, type=typ, flags=flags, addr=addr,
+                    offset=offset, size=size, link=link, entsize=entsize,
+                )
+            )
+
+        if shstrndx < len(raw):
+            strtab = raw[shstrndx]
+            for sec in raw:
+                sec["name"] = self._cstr(strtab["offset"] + sec["name_ofs"])
+        return raw
+
+    def _cstr(self, ofs):
+        end = self.data.index(b"\0", ofs)
+        return self.data[ofs:end].decode("ascii", errors="replace")
+
+    def _read_symbols(self):
+        symtabs = [s for s in self.sections if s["type"] == SHT_SYMTAB]
+        if not symtabs:  # stripped binary, fall back to dynamic symbols
+            symtabs = [s for s in self.sections if s["type"] == SHT_DYNSYM]
+
+        for sec in symtabs:
+            strtab = self.sections[sec["link"]]
+            ent = sec["entsize"]
+            for ofs in range(sec["offset"], sec["offset"] + sec["size"], ent):
+                if self.is_64:
+                    name, info, _, shndx, value, size = self._unpack(
+                        "IBBHQQ", ofs
+                    )
+                else:
+                    name, value, size, info, _, shndx = self._unpack(
+                        "IIIBBH", ofs
+                    )
+                if name == 0 or shndx == 0:
+                    continue
+                sym_name = self._cstr(strtab["offset"] + name)
+                self.symbols.setdefault(sym_name, value)
+                if info & 0xF == STT_FUNC:
+                    self.funcs.append((value, size, sym_name))
+        self.funcs.sort()
+
+    # -------------------------------------------------------------------------
+    # address of a symbol by name (None if not found)
+    # -------------------------------------------------------------------------
+    def symbol_addr(self, name):
+        return self.symbols.get(name)
+
+    # -------------------------------------------------------------------------
+    # contents of a section by name (None if not found)
+    # -------------------------------------------------------------------------
+    def section_data(self, name):
+        for sec in self.sections:
+            if sec.get("name") == name:
+                return self.data[sec["offset"] : sec["offset"] + sec["size"]]
+        return None
+
+    # -------------------------------------------------------------------------
+    # nul terminated string at a given address of the program image, e.g. a
+    # string literal in .rodata (None if not found in the file)
+    # -------------------------------------------------------------------------
+    def read_cstr(self, addr):
+        for sec in self.sections:
+            if not sec["flags"] & SHF_ALLOC or sec["type"] == SHT_NOBITS:
+                continue
+            if sec["addr"] <= addr < sec["addr"] + sec["size"]:
+                return self._cstr(sec["offset"] + addr - sec["addr"])
+        return None
+
+    # -------------------------------------------------------------------------
+    # unpack a 32 bit word from a buffer with the endianness of the file
+    # -------------------------------------------------------------------------
+    def unpack_u32(self, buf, ofs):
+        return struct.unpack_from(self.endian + "I", buf, ofs)[0]
+
+    # -------------------------------------------------------------------------
+    # name of the function containing addr (None if not found)
+    # -------------------------------------------------------------------------
+    def func_at(self, addr):
+        k = bisect.bisect_right(self.func_addrs, addr) - 1
+        if k < 0:
+            return None
+        start, size, name = self.funcs[k]
+        if addr == start or addr < start + max(size, 1):
+            return name
+        return None
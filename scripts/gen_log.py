@@ -24,31 +24,147 @@
 # -----------------------------------------------------------------------------
 import re
 import sys
+import shlex
+import struct
 import argparse
+from elf_reader import ElfFile
 
 
-# | TS[32:0] | TS64 | FLAG_VAL |  ID[7:0] |
+# | TS[31:ID_BITS+2] | TS64 | FLAG_VAL |  ID[ID_BITS-1:0] |
+#
+# The encoding is set by set_encoding() from --id_bits / --ts_prescale (or
+# from the dump header). The time-stamps logged are ts >> TS_PRESCALE
+
+EMB_LOG_ID_BITS_DEFAULT = 6
+
+
+def set_encoding(id_bits, ts_prescale):
+    global EMB_LOG_ID_BITS, EMB_LOG_TS_PRESCALE
+    global EMB_LOG_TS_SHIFT, EMB_LOG_TS64_BIT, EMB_LOG_FLAG_VAL_BIT
+    global EMB_LOG_TS64_MASK, EMB_LOG_FLAG_VAL_MASK
+    global EMB_LOG_IDX_MAX, EMB_LOG_TS_MAX, EMB_LOG_FUNC_ID
+
+    if not 1 <= id_bits <= 24 or not 0 <= ts_prescale <= 31:
+        print(
+            f"ERROR: invalid encoding id_bits={id_bits} "
+            f"ts_prescale={ts_prescale}",
+            file=sys.stderr,
+        )
+        sys.exit(1)
+
+    EMB_LOG_ID_BITS = id_bits
+    EMB_LOG_TS_PRESCALE = ts_prescale
+
+    EMB_LOG_TS_SHIFT = id_bits + 2
+    EMB_LOG_TS64_BIT = id_bits + 1
+    EMB_LOG_FLAG_VAL_BIT = id_bits
+
+    EMB_LOG_TS64_MASK = 1 << EMB_LOG_TS64_BIT
+    EMB_LOG_FLAG_VAL_MASK = 1 << EMB_LOG_FLAG_VAL_BIT
+
+    # max message id
+    EMB_LOG_IDX_MAX = EMB_LOG_FLAG_VAL_MASK - 1
+
+    # max time-stamp that fits in first word
+    EMB_LOG_TS_MAX = (1 << (32 - EMB_LOG_TS_SHIFT)) - 1
+
+    # id reserved for function entry/exit tracing (-finstrument-functions),
+    # only when built with it (see set_func_trace())
+    EMB_LOG_FUNC_ID = EMB_LOG_IDX_MAX
 
-EMB_LOG_TS_SHIFT = 8
-EMB_LOG_TS64_BIT = 7
-EMB_LOG_FLAG_VAL_BIT = 6
 
-EMB_LOG_TS64_MASK = 1 << EMB_LOG_TS64_BIT
-EMB_LOG_FLAG_VAL_MASK = 1 << EMB_LOG_FLAG_VAL_BIT
+set_encoding(EMB_LOG_ID_BITS_DEFAULT, 0)
 
-# max message id
-EMB_LOG_IDX_MAX = EMB_LOG_FLAG_VAL_MASK - 1
 
-# max time-stamp that fits in first word
-EMB_LOG_TS_MAX = (1 << (32 - EMB_LOG_TS_SHIFT)) - 1
+# Whether the target is built with EMB_LOG_FUNC_TRACE (--func_trace or the
+# dump header). Only then EMB_LOG_FUNC_ID is reserved and decoded
+def set_func_trace(on):
+    global EMB_LOG_FUNC_TRACE
+    EMB_LOG_FUNC_TRACE = on
+
+
+set_func_trace(False)
+
+
+# number of message ids available to msgs.txt
+def max_msgs():
+    return EMB_LOG_FUNC_ID if EMB_LOG_FUNC_TRACE else EMB_LOG_IDX_MAX + 1
+
+
+EMB_LOG_FUNC_FMT = [("func", "flag"), ("fn", "u32")]
+
+# argument types and the number of words each one takes in the buffer:
+#   u32  32 bit unsigned integer
+#   str  constant string, logged as its address (offset from emb_log_init)
+#        and read from the ELF file on the host
+#   f32  float, its bits
+#   f64  double, its bits in two words
+EMB_LOG_ARG_WORDS = {"u32": 1, "str": 1, "f32": 1, "f64": 2}
+
+# function and string addresses are logged as an offset from this symbol
+EMB_LOG_ADDR_BASE_SYM = "emb_log_init"
+
+# message table emitted by the C++ API (emb_log.hpp): records of a 32 bit id
+# followed by the message line as in msgs.txt, nul terminated
+EMB_LOG_MSGS_SECTION = ".emb_log_msgs"
+EMB_LOG_MSGS_RECORD_LEN = 256
+
+# channel used by messages not assigning one explicitly
+EMB_LOG_DEFAULT_CHAN = "main"
+
+# channel settings and their default values
+EMB_LOG_CHAN_DEFAULTS = {
+    "entries": "EMB_LOG_ENTRIES",
+    "one_shot": 0,
+    "start_after": -1,
+    "stop_after": -1,
+}
 
 
 class MsgInfo:
     def __init__(self):
         self.dec_lst = []
         self.msg_ids = []
-        self.msg_type_by_id = dict()
-        self.msg_type_by_idx = dict()
+        self.msg_type_by_id = {"func": "flag"}
+        self.fmt_by_id = dict()  # printf-style template by message name
+        self.chans = {EMB_LOG_DEFAULT_CHAN: dict(EMB_LOG_CHAN_DEFAULTS)}
+
+    # format of a message given its index, None if unknown
+    def msg_format(self, msg_idx):
+        if EMB_LOG_FUNC_TRACE and msg_idx == EMB_LOG_FUNC_ID:
+            return EMB_LOG_FUNC_FMT
+        if msg_idx < len(self.dec_lst):
+            return self.dec_lst[msg_idx]
+        return None
+
+
+# -----------------------------------------------------------------------------
+# Map function and string offsets found in the trace into function names and
+# strings using the ELF file of the traced application (if provided)
+# -----------------------------------------------------------------------------
+class Symbolizer:
+    def __init__(self, elf_file=None):
+        self.elf = ElfFile(elf_file) if elf_file else None
+        self.base = None
+        if self.elf:
+            self.base = self.elf.symbol_addr(EMB_LOG_ADDR_BASE_SYM)
+        self.cache = dict()
+
+    def name(self, ofs):
+        if ofs not in self.cache:
+            ofs_signed = ofs - (1 << 32) if ofs & 0x80000000 else ofs
+            name = None
+            if self.base is not None:
+                name = self.elf.func_at(self.base + ofs_signed)
+            self.cache[ofs] = name if name else f"fn_{ofs:08x}"
+        return self.cache[ofs]
+
+    def string(self, ofs):
+        ofs_signed = ofs - (1 << 32) if ofs & 0x80000000 else ofs
+        txt = None
+        if self.base is not None:
+            txt = self.elf.read_cstr(self.base + ofs_signed)
+        return txt if txt is not None else f"str@{ofs:08x}"
 
 
 # -----------------------------------------------------------------------------
@@ -58,45 +174,159 @@ def msg_id_type(x):
     return x == "event" or x == "flag"
 
 
+# -----------------------------------------------------------------------------
+# Return True if the key is a message attribute rather than an argument
+# -----------------------------------------------------------------------------
+def msg_attr_key(x):
+    return x == "level" or x == "chan" or x == "fmt"
+
+
+# -----------------------------------------------------------------------------
+# Number of words taken by the arguments of a decoded message
+# -----------------------------------------------------------------------------
+def arg_words(xargs):
+    return sum(EMB_LOG_ARG_WORDS[typ] for _, typ, _ in xargs)
+
+
+# -----------------------------------------------------------------------------
+# Value of a decoded argument as a python object (int, str, float)
+# -----------------------------------------------------------------------------
+def arg_value(typ, val, symb):
+    if typ == "str":
+        return symb.string(val)
+    if typ == "f32":
+        return struct.unpack("<f", struct.pack("<I", val))[0]
+    if typ == "f64":
+        return struct.unpack("<d", struct.pack("<Q", val))[0]
+    return val
+
+
+# -----------------------------------------------------------------------------
+# Render the arguments of a decoded message, with its fmt: template if it has
+# one, as name=value pairs otherwise
+# -----------------------------------------------------------------------------
+def format_args(msg_info: MsgInfo, id, xargs, symb):
+    values = [arg_value(typ, val, symb) for _, typ, val in xargs]
+    fmt = msg_info.fmt_by_id.get(id)
+    if fmt is not None:
+        try:
+            return fmt % tuple(values)
+        except (TypeError, ValueError):
+            pass  # bad template for these values, show them raw
+    args = []
+    for (name, typ, _), v in zip(xargs, values):
+        if typ == "u32":
+            args.append(f"{name}={v:#x}")
+        elif typ == "str":
+            args.append(f'{name}="{v}"')
+        elif typ == "f32":
+            args.append(f"{name}={v:.7g}")
+        else:
+            args.append(f"{name}={v:.15g}")
+    return ", ".join(args)
+
+
+# -----------------------------------------------------------------------------
+# Process a channel declaration line:
+#   channel:<name> [entries:<int>] [one_shot:<0|1>] [start_after:<int>]
+#                  [stop_after:<int>]
+# -----------------------------------------------------------------------------
+def process_chan_line(msg_info: MsgInfo, kv_list):
+    _, chan = kv_list[0]
+    if chan in msg_info.chans and chan != EMB_LOG_DEFAULT_CHAN:
+        print(f"ERROR: channel '{chan}' declared twice", file=sys.stderr)
+        sys.exit(1)
+    cfg = msg_info.chans.setdefault(chan, dict(EMB_LOG_CHAN_DEFAULTS))
+    for name, val in kv_list[1:]:
+        if name not in EMB_LOG_CHAN_DEFAULTS:
+            print(f"ERROR: unknown channel setting '{name}'", file=sys.stderr)
+            sys.exit(1)
+        cfg[name] = int(val)
+
+
 # -----------------------------------------------------------------------------
 # Process one line of the file that contains the message formats
 # -----------------------------------------------------------------------------
 def process_msg_fmt_line(msg_info: MsgInfo, fout_hdrs, line):
+    # fmt:"..." values are quoted and can contain spaces and colons
     def line_to_kv_pairs(line):
         kv_list = []
-        for part in re.split(r"\s+", line):
-            (name, val) = re.split(r"\s*:\s*", part.strip())
-            kv_list.append([name, val])
+        for part in shlex.split(line):
+            (name, val) = part.split(":", 1)
+            kv_list.append([name.strip(), val.strip()])
         return kv_list
 
     kv_list = line_to_kv_pairs(line)
+    if kv_list[0][0] == "channel":
+        process_chan_line(msg_info, kv_list)
+        return
+
     msg_id = None
     msg_t = None
     struct_data = []
     level = 1
+    chan = EMB_LOG_DEFAULT_CHAN
+    fmt = None
     for name, typ_or_value in kv_list[::-1]:
         if msg_id_type(typ_or_value):
             msg_id = name
             msg_t = typ_or_value
         elif name == "level":
             level = int(typ_or_value)
-        else:
-            assert typ_or_value in {"u32"}
+        elif name == "chan":
+            chan = typ_or_value
+        elif name == "fmt":
+            fmt = typ_or_value
+        elif typ_or_value in EMB_LOG_ARG_WORDS:
             struct_data.append((typ_or_value, name))
+        else:
+            print(
+                f"ERROR: unknown type '{typ_or_value}' of argument '{name}'",
+                file=sys.stderr,
+            )
+            sys.exit(1)
+
+    if msg_id in msg_info.msg_type_by_id:
+        print(
+            f"ERROR: message name '{msg_id}' already in use", file=sys.stderr
+        )
+        sys.exit(1)
+
+    if chan not in msg_info.chans:
+        print(
+            f"ERROR: message '{msg_id}' uses undeclared channel '{chan}'",
+            file=sys.stderr,
+        )
+        sys.exit(1)
 
     msg_idx = len(msg_info.dec_lst)
-    if msg_idx > EMB_LOG_IDX_MAX:
+    if msg_idx >= max_msgs():
         print(
-            f"ERROR: exceeding max number of events allowed {EMB_LOG_IDX_MAX}. "
-            "Please increase EMB_LOG_TS_SHIFT",
+            f"ERROR: exceeding max number of events allowed {max_msgs()}. "
+            "Please increase --id_bits",
             file=sys.stderr,
         )
         sys.exit(1)
 
+    if fmt is not None:
+        # try the template with dummy values so errors show up now
+        dummy = {"u32": 0, "str": "", "f32": 0.0, "f64": 0.0}
+        try:
+            fmt % tuple(dummy[typ] for typ, _ in struct_data[::-1])
+        except (TypeError, ValueError) as e:
+            print(
+                f"ERROR: fmt of message '{msg_id}' doesn't match its "
+                f"arguments: {e}",
+                file=sys.stderr,
+            )
+            sys.exit(1)
+        msg_info.fmt_by_id[msg_id] = fmt
+
     msg_info.msg_ids.append(f"{msg_id}={msg_idx:#x}")
-    msg_info.dec_lst.append([(n, v) for n, v in kv_list if n != "level"])
+    msg_info.dec_lst.append(
+        [(n, v) for n, v in kv_list if not msg_attr_key(n)]
+    )
     msg_info.msg_type_by_id[msg_id] = msg_t
-    msg_info.msg_type_by_idx[msg_idx] = msg_t
 
     if fout_hdrs:
         assert msg_id is not None
@@ -112,7 +342,9 @@ def process_msg_fmt_line(msg_info: MsgInfo, fout_hdrs, line):
             + ";"
         )
         arg_lst = [
-            n for n, v in kv_list if not msg_id_type(v) and n != "level"
+            n
+            for n, v in kv_list
+            if not msg_id_type(v) and not msg_attr_key(n)
         ]
 
         ext_arg_lst = arg_lst[:]
@@ -124,8 +356,11 @@ def process_msg_fmt_line(msg_info: MsgInfo, fout_hdrs, line):
         define += (
             ")  EMB_LOG_IF(" + str(level) + ", " + struct_typ + " m; \\\n    "
         )
+        arg_conv = {"u32": "%s", "f32": "%s", "str": "EMB_LOG_STR(%s)"}
+        arg_conv["f64"] = "emb_log_f64(%s)"
         define += " ".join(
-            map(lambda n: "m." + n + "_arg=" + n + "; ", arg_lst)
+            "m.%s_arg=%s; " % (n, arg_conv[typ] % n)
+            for typ, n in struct_data[::-1]
         )
 
         if msg_t == "event":
@@ -136,7 +371,8 @@ def process_msg_fmt_line(msg_info: MsgInfo, fout_hdrs, line):
             print(f"ERROR: incorrect msg_id type {msg_t}")
             sys.exit(1)
 
-        define += " \\\n    emb_log_add(&m, sizeof(m)))"
+        chan_ref = f"&emb_log_chans[EMB_LOG_CHAN_{chan.upper()}]"
+        define += f" \\\n    emb_log_add_to({chan_ref}, &m, sizeof(m)))"
         print("//", line, file=fout_hdrs)
         print(f"// id={msg_idx}", file=fout_hdrs)
         print(typedef, file=fout_hdrs)
@@ -144,15 +380,27 @@ def process_msg_fmt_line(msg_info: MsgInfo, fout_hdrs, line):
 
 
 # -----------------------------------------------------------------------------
-# Decode the hex log and put it in formatted list (most recent last)
+# Decode the hex log and put it in formatted list (most recent last). Words
+# not making a whole valid message (e.g. the remains of a message partially
+# overwritten at the wrap point) are skipped, counting them in stats
 # -----------------------------------------------------------------------------
-def process_hex_log(msg_info: MsgInfo, msg_formats, hex_dump, formated, i):
+def process_hex_log(msg_info: MsgInfo, hex_dump, formated, i, stats=None):
+    if stats is None:
+        stats = dict()
+    stats.setdefault("skipped_words", 0)
+    stats.setdefault("skipped_entries", 0)
+
+    def skip(start, end):
+        stats["skipped_words"] += end - start
+        stats["skipped_entries"] += 1
+        return end
 
     # decode the message ID word
     def unpack_msg_id(h):
         msg = int(h, 16)
         msg_idx = msg & EMB_LOG_IDX_MAX
-        is_flag = msg_info.msg_type_by_idx[msg_idx] == "flag"
+        fmt = msg_info.msg_format(msg_idx)
+        is_flag = fmt is not None and fmt[0][1] == "flag"
         flag_val = 1 if msg & EMB_LOG_FLAG_VAL_MASK else 0
         flag_ts64 = 1 if msg & EMB_LOG_TS64_MASK else 0
         delta_ts = (msg >> EMB_LOG_TS_SHIFT) & EMB_LOG_TS_MAX
@@ -163,45 +411,54 @@ def process_hex_log(msg_info: MsgInfo, msg_formats, hex_dump, formated, i):
     # skip entries that look invalid
     invalid = True
     while invalid:
+        start = i
         msg_idx, is_flag, flag_val, flag_ts64, delta_ts = unpack_msg_id(
             hex_dump[i]
         )
         i += 1
         if delta_ts == EMB_LOG_TS_MAX:
             if i >= dump_len:
-                return i
+                return skip(start, i)
             delta_ts = int(hex_dump[i], 16)
             i += 1
         if flag_ts64 == 1:
             if i >= dump_len:
-                return i
+                return skip(start, i)
             delta_ts |= int(hex_dump[i], 16) << 32
             i += 1
-        invalid = msg_idx >= len(msg_formats)
+        fmt = msg_info.msg_format(msg_idx)
+        invalid = fmt is None
         if invalid:
-            print("Skipping entry", file=sys.stderr)
-
-    fmt = msg_formats[msg_idx]
+            skip(start, i)
+            if i >= dump_len:
+                return i
 
     id, _ = fmt[0]
 
     xargs = []
-    for j in range(1, len(fmt)):
-        if i >= dump_len:
-            return i
-        h = int(hex_dump[i], 16)
-        xargs.append(f"{fmt[j][0]}={h:#x}")
-        i += 1
+    for name, typ in fmt[1:]:
+        if i + EMB_LOG_ARG_WORDS[typ] > dump_len:
+            return skip(start, dump_len)
+        h = 0
+        for _ in range(EMB_LOG_ARG_WORDS[typ]):  # most significant first
+            h = (h << 32) | int(hex_dump[i], 16)
+            i += 1
+        xargs.append((name, typ, h))
 
     formated.insert(0, [delta_ts, id, flag_val if is_flag else -1, xargs])
     return i
 
 
 # -----------------------------------------------------------------------------
-# Capture hex file dump from circular buffer
+# Capture hex file dumps from the circular buffers of each channel as well as
+# the key=value header lines preceding them. Lines before the first channel=
+# go to the global header. Returns the global header and a dict of channels
+# by name, each with its own header and hex dump (the last dump found wins)
 # -----------------------------------------------------------------------------
 def capture_hex_buffer(hex_log):
-    hex_dump = []
+    header = dict()
+    chans = dict()
+    chan = None
     with open(hex_log) as fin_hex:
         capturing = False
         for line in fin_hex:
@@ -213,22 +470,339 @@ def capture_hex_buffer(hex_log):
                     capturing = False
                 else:
                     parts = re.split(r"\s+", line)
-                    hex_dump.extend(parts)
+                    chan["hex_dump"].extend(parts)
             elif line.startswith("=== Start buffer dump"):
-                hex_dump = []
+                if chan is None:  # dump w/o channels, single log
+                    chan = dict(header=dict(header))
+                    chans[EMB_LOG_DEFAULT_CHAN] = chan
+                chan["hex_dump"] = []
                 capturing = True
-    return hex_dump
+            elif line.startswith("channel="):
+                chan = dict(header=dict(), hex_dump=[])
+                chans[line.split("=", 1)[1]] = chan
+            elif re.match(r"^\w+=\S+$", line):
+                key, val = line.split("=", 1)
+                (chan["header"] if chan else header)[key] = val
+    return header, chans
 
 
-def extract_hex_msgs(msg_info: MsgInfo, hex_dump):
+def extract_hex_msgs(msg_info: MsgInfo, hex_dump, stats=None):
     formated = []
     k = 0
     while k < len(hex_dump):
-        k = process_hex_log(msg_info, msg_info.dec_lst, hex_dump, formated, k)
+        k = process_hex_log(msg_info, hex_dump, formated, k, stats)
+
+    # back from prescaled time-stamps to ticks
+    for msg in formated:
+        msg[0] <<= EMB_LOG_TS_PRESCALE
     return formated
 
 
-def dump_human_rpt(msg_info: MsgInfo, hex_dump, freq_in_mhz, file_out):
+# -----------------------------------------------------------------------------
+# Decode all channels and merge them into a single timeline (most recent
+# last). Each channel time-stamps relative to its own previous message, the
+# absolute time-stamp of its last message (last_ts= in its header) anchors it
+# to the common time base. The oldest message keeps its own delta. The
+# decoding stats of each channel are left in its "stats" entry
+# -----------------------------------------------------------------------------
+def merge_channels(msg_info: MsgInfo, chans):
+    timeline = []
+    for chan_idx, chan in enumerate(chans.values()):
+        stats = chan["stats"] = dict(skipped_words=0, skipped_entries=0)
+        formated = extract_hex_msgs(msg_info, chan["hex_dump"], stats)
+        stats["decoded"] = len(formated)
+        # time covered by the ring, from its oldest message to the dump
+        stats["ring_span"] = sum(msg[0] for msg in formated[1:])
+        abs_ts = int(chan["header"].get("last_ts", "0"), 16)
+        abs_ts <<= EMB_LOG_TS_PRESCALE
+        for k in range(len(formated) - 1, -1, -1):
+            timeline.append((abs_ts, chan_idx, k, formated[k]))
+            stats["oldest_ts"] = abs_ts
+            abs_ts -= formated[k][0]
+
+    timeline.sort(key=lambda x: x[:3])
+
+    merged = []
+    prev_ts = None
+    for abs_ts, _, _, msg in timeline:
+        if prev_ts is not None:
+            msg[0] = abs_ts - prev_ts
+        prev_ts = abs_ts
+        merged.append(msg)
+    return merged
+
+
+# -----------------------------------------------------------------------------
+# Logging overhead attributed to each message, given the per message cost
+# calibrated by emb_log_init() (overhead_ticks=... in the dump header) indexed
+# by number of argument words. The time-stamp is taken before the arguments are
+# stored, so the cost of a message shows up in the delta of the next one.
+# Nothing is attributed to the oldest message as its predecessor is unknown
+# -----------------------------------------------------------------------------
+def logging_overhead(formated, overhead_ticks):
+    ovh = []
+    prev_words = None
+    for delta_ts, id, flag_val, xargs in formated:
+        if prev_words is None:
+            ovh.append(0)
+        else:
+            cost = overhead_ticks[min(prev_words, len(overhead_ticks) - 1)]
+            ovh.append(min(cost, delta_ts))
+        prev_words = arg_words(xargs)
+    return ovh
+
+
+# -----------------------------------------------------------------------------
+# Time span (in ticks) that all channels still cover, up to the most recent
+# message, and the logging overhead within it. Before the most recent of the
+# oldest messages of each channel only the channels that keep a longer history
+# have data, so counting it would understate the overhead. formated and ovh
+# are as returned by merge_channels() and logging_overhead()
+# -----------------------------------------------------------------------------
+def common_span_overhead(formated, ovh, chans):
+    oldest = [
+        chan["stats"]["oldest_ts"]
+        for chan in chans.values()
+        if chan["stats"]["decoded"]
+    ]
+    if not oldest:
+        return 0, 0
+    start = max(oldest)
+    abs_ts = min(oldest)
+    span = 0
+    ovh_in_span = 0
+    for msg, ovh_ticks in zip(formated[1:], ovh[1:]):
+        if abs_ts >= start:
+            span += msg[0]
+            ovh_in_span += ovh_ticks
+        abs_ts += msg[0]
+    return span, ovh_in_span
+
+
+# -----------------------------------------------------------------------------
+# Durations (in ticks) of each flag message while set, by flag name
+# -----------------------------------------------------------------------------
+def flag_intervals(msg_info: MsgInfo, formated):
+    intervals = dict()
+    set_at = dict()
+    abs_ts = 0
+    for delta_ts, id, flag_val, xargs in formated:
+        abs_ts += delta_ts
+        if id == "func" or msg_info.msg_type_by_id[id] != "flag":
+            continue
+        if flag_val == 1:
+            set_at.setdefault(id, []).append(abs_ts)
+        elif set_at.get(id):
+            intervals.setdefault(id, []).append(abs_ts - set_at[id].pop())
+    return intervals
+
+
+# -----------------------------------------------------------------------------
+# Follow function entry/exit events keeping track of the call stack. Returns
+# per message the call depth (-1 for non function messages) and the function
+# name. Exits whose entry was lost (e.g. overwritten at wrap around) are
+# reported at depth 0
+# -----------------------------------------------------------------------------
+def track_calls(formated, symb: Symbolizer):
+    stack = []
+    calls = []
+    for delta_ts, id, flag_val, xargs in formated:
+        if id != "func":
+            calls.append((-1, None))
+            continue
+        name = symb.name(xargs[0][2])
+        if flag_val == 1:
+            calls.append((len(stack), name))
+            stack.append(name)
+        elif name in stack:
+            while stack.pop() != name:
+                pass
+            calls.append((len(stack), name))
+        else:
+            calls.append((0, name))
+    return calls
+
+
+# -----------------------------------------------------------------------------
+# Generate a folded stack file (one 'f1;f2;f3 self_ticks' line per stack)
+# suitable for flamegraph.pl / speedscope etc.
+# -----------------------------------------------------------------------------
+def dump_folded_stacks(formated, symb, file_out):
+    folded = dict()
+    stack = []  # [name, enter_ts, ticks spent in callees]
+
+    def close_frame(ts):
+        name, enter_ts, child = stack.pop()
+        key = ";".join([f[0] for f in stack] + [name])
+        folded[key] = folded.get(key, 0) + (ts - enter_ts) - child
+        if stack:
+            stack[-1][2] += ts - enter_ts
+
+    abs_ts = 0
+    for delta_ts, id, flag_val, xargs in formated:
+        abs_ts += delta_ts
+        if id != "func":
+            continue
+        name = symb.name(xargs[0][2])
+        if flag_val == 1:
+            stack.append([name, abs_ts, 0])
+        elif name in [f[0] for f in stack]:
+            while stack[-1][0] != name:
+                close_frame(abs_ts)
+            close_frame(abs_ts)
+
+    # frames still open at dump time are closed at the last time-stamp
+    while stack:
+        close_frame(abs_ts)
+
+    with open(file_out, "w") as fout:
+        for key, ticks in sorted(folded.items()):
+            print(f"{key} {ticks}", file=fout)
+
+
+# -----------------------------------------------------------------------------
+# Words needed to log the captured messages for every encoding with id_bits
+# large enough for the messages defined and prescale up to max_prescale.
+# Reports the best ones and recommends the one with fewest words (ties
+# favour a lower prescale, i.e. better time resolution, then the id_bits
+# closest to the current ones)
+# -----------------------------------------------------------------------------
+def recommend_split(msg_info: MsgInfo, chans, max_prescale, file_out):
+    num_ids = len(msg_info.dec_lst) + (1 if EMB_LOG_FUNC_TRACE else 0)
+    min_id_bits = max(1, (num_ids - 1).bit_length())
+
+    # deltas are relative to the previous message of the same channel
+    chan_msgs = [
+        extract_hex_msgs(msg_info, chan["hex_dump"])
+        for chan in chans.values()
+    ]
+    num_msgs = sum(len(formated) for formated in chan_msgs)
+
+    def words_needed(id_bits, prescale):
+        ts_max = (1 << (32 - id_bits - 2)) - 1
+        words = 0
+        for formated in chan_msgs:
+            abs_ts = 0
+            for delta_ts, id, flag_val, xargs in formated:
+                # prescaling applies to absolute time-stamps, not to deltas
+                ts = ((abs_ts + delta_ts) >> prescale) - (abs_ts >> prescale)
+                abs_ts += delta_ts
+                words += 1 + arg_words(xargs)
+                if ts >= 1 << 32:
+                    words += 2
+                elif ts >= ts_max:
+                    words += 1
+        return words
+
+    results = []
+    for id_bits in range(min_id_bits, 25):
+        for prescale in range(max_prescale + 1):
+            words = words_needed(id_bits, prescale)
+            dist = abs(id_bits - EMB_LOG_ID_BITS)
+            results.append((words, prescale, dist, id_bits))
+    results.sort()
+    current = words_needed(EMB_LOG_ID_BITS, EMB_LOG_TS_PRESCALE)
+
+    with open(file_out, "w") as fout:
+
+        def dump(*args, **kwargs):
+            print(*args, **kwargs, file=fout)
+
+        dump(
+            "%d messages, %d words with current encoding "
+            "(--id_bits %d --ts_prescale %d)"
+            % (num_msgs, current, EMB_LOG_ID_BITS, EMB_LOG_TS_PRESCALE)
+        )
+        dump("id_bits  ts_prescale  ts_max_ticks       words  vs-current")
+        for words, prescale, _, id_bits in results[:10]:
+            ts_max = ((1 << (32 - id_bits - 2)) - 1) << prescale
+            dump(
+                "%7d  %11d  %12d  %10d  %9.1f%%"
+                % (
+                    id_bits,
+                    prescale,
+                    ts_max,
+                    words,
+                    100.0 * words / current if current else 0.0,
+                )
+            )
+        words, prescale, _, id_bits = results[0]
+        dump(f"recommended: --id_bits {id_bits} --ts_prescale {prescale}")
+
+
+# -----------------------------------------------------------------------------
+# Per channel summary of what was captured and lost, from the counters in the
+# dump header and the decoding stats left by merge_channels(). Helps sizing
+# the channels: how long a time the ring covered at dump time vs the whole
+# capture and the peak rate it had to absorb
+# -----------------------------------------------------------------------------
+def dump_capture_stats(chans, header, cycles_to_us, dump):
+    drops = ["disabled", "pre_start", "stopped", "one_shot"]
+    for name, chan in chans.items():
+        hdr = chan["header"]
+        stats = chan.get("stats", dict())
+        if "captured" not in hdr:  # dump w/o loss accounting
+            continue
+        attempted = int(hdr["evnt_cnt"])
+        captured = int(hdr["captured"])
+        dump(
+            "channel %s: %d attempted, %d captured, %d dropped (%s)"
+            % (
+                name,
+                attempted,
+                captured,
+                attempted - captured,
+                ", ".join(
+                    "%s %s" % (d, hdr.get("drop_" + d, "?")) for d in drops
+                ),
+            )
+        )
+        words = int(hdr["words"])
+        max_entries = int(hdr["max_entries"])
+        overwritten = words - max_entries if int(hdr["wrapped"]) else 0
+        dump(
+            "  ring: %d words, %d written, %d overwritten, %d messages "
+            "decoded, %d words skipped in %d partial entries"
+            % (
+                max_entries,
+                words,
+                max(overwritten, 0),
+                stats.get("decoded", 0),
+                stats.get("skipped_words", 0),
+                stats.get("skipped_entries", 0),
+            )
+        )
+        capture = int(hdr["last_ts"], 16) - int(hdr["first_ts"], 16)
+        capture <<= EMB_LOG_TS_PRESCALE
+        ring_span = stats.get("ring_span", 0)
+        dump(
+            "  ring covers %.3f uSecs of %.3f uSecs captured (%.1f%%)"
+            % (
+                cycles_to_us(ring_span),
+                cycles_to_us(capture),
+                100.0 * ring_span / capture if capture else 100.0,
+            )
+        )
+        if "rate_window" in header:
+            window = int(header["rate_window"])
+            peak = int(hdr["peak_win_words"])
+            win_us = cycles_to_us(window)
+            dump(
+                "  peak rate: %d words in %.3f uSecs, %.0f words/sec"
+                % (peak, win_us, 1e6 * peak / win_us if win_us else 0.0)
+            )
+
+
+def dump_human_rpt(
+    msg_info: MsgInfo,
+    formated,
+    symb,
+    freq_in_mhz,
+    ovh_summary,
+    chans,
+    header,
+    file_out,
+):
 
     with open(file_out, "w") as fout:
 
@@ -241,7 +815,7 @@ def dump_human_rpt(msg_info: MsgInfo, hex_dump, freq_in_mhz, file_out):
         def cycles_to_us(cycles):
             return cycles / (1.0 * freq_in_mhz)
 
-        formated = extract_hex_msgs(msg_info, hex_dump)
+        calls = track_calls(formated, symb)
 
         # dump header depending on output style
         dump(
@@ -257,25 +831,70 @@ def dump_human_rpt(msg_info: MsgInfo, hex_dump, freq_in_mhz, file_out):
             delta_ts, id, flag_val, xargs = msg
             abs_ts += delta_ts
             dump(
-                "%4d : %12d    %10.3f   %10.3f  %s"
+                "%4d : %12d    %10.3f   %10.3f  "
                 % (
                     cnt,
                     abs_ts,
                     cycles_to_us(abs_ts),
                     cycles_to_us(delta_ts),
-                    id,
                 ),
                 end="",
             )
+            depth, func_name = calls[cnt]
+            if func_name is not None:
+                arrow = "->" if flag_val == 1 else "<-"
+                dump("%s%s %s" % ("  " * depth, arrow, func_name))
+                continue
+            dump(id, end="")
             if flag_val != -1:
                 dump("(%d)" % flag_val, end="")
             if len(xargs) > 0:
-                dump(" %s" % (", ".join(xargs)), end="")
+                dump(" %s" % format_args(msg_info, id, xargs, symb), end="")
             dump()
 
+        # dump summary
+        dump(
+            "==============================================================="
+        )
+        if ovh_summary is not None:
+            span, ovh, compensated = ovh_summary
+            pct = 100.0 * ovh / span if span else 0.0
+            dump(
+                "observed span %.3f uSecs, logging overhead %.3f uSecs "
+                "(%.2f%%)%s"
+                % (
+                    cycles_to_us(span),
+                    cycles_to_us(ovh),
+                    pct,
+                    ", subtracted from deltas" if compensated else "",
+                )
+            )
+
+        dump_capture_stats(chans, header, cycles_to_us, dump)
+
+        intervals = flag_intervals(msg_info, formated)
+        if intervals:
+            dump(
+                "flag intervals:      count     min-uSecs     avg-uSecs"
+                "     max-uSecs"
+            )
+        for id, durations in intervals.items():
+            dump(
+                "  %-16s %8d  %12.3f  %12.3f  %12.3f"
+                % (
+                    id,
+                    len(durations),
+                    cycles_to_us(min(durations)),
+                    cycles_to_us(sum(durations) / len(durations)),
+                    cycles_to_us(max(durations)),
+                )
+            )
+
 
-def dump_internal_trace(msg_info: MsgInfo, hex_dump, freq_in_mhz, file_out):
-    formated = extract_hex_msgs(msg_info, hex_dump)
+def dump_internal_trace(
+    msg_info: MsgInfo, formated, symb, freq_in_mhz, file_out
+):
+    calls = track_calls(formated, symb)
 
     with open(file_out, "w") as fout:
 
@@ -287,18 +906,30 @@ def dump_internal_trace(msg_info: MsgInfo, hex_dump, freq_in_mhz, file_out):
 
         # dump header depending on output style
         flag_ids = [
-            k for k, v in msg_info.msg_type_by_id.items() if msg_id_type(v)
+            k for k, v in msg_info.msg_type_by_id.items()
+            if msg_id_type(v) and k != "func"
         ]
         for k in flag_ids:
             dump("0 PUSH_VAR %s bit" % (k))
 
+        # each traced function shows as a flag, high while it is executing
+        func_names = sorted({n for _, n in calls if n is not None})
+        for k in func_names:
+            dump("0 PUSH_VAR func_%s bit" % (k))
+        if func_names:
+            dump("0 PUSH_VAR func_depth u32")
+
         # dump trace
         abs_ts = 0
         for cnt, msg in enumerate(formated):
             delta_ts, id, flag_val, xargs = msg
             abs_ts += delta_ts
             type_ = msg_info.msg_type_by_id[id]
-            if type_ == "event":
+            depth, func_name = calls[cnt]
+            if func_name is not None:
+                dump("%d TRACE_VAR func_%s %d" % (abs_ts, func_name, flag_val))
+                dump("%d TRACE_VAR func_depth %d" % (abs_ts, depth + flag_val))
+            elif type_ == "event":
                 dump("%d EVENT %s" % (abs_ts, id))
             elif type_ == "flag":
                 dump("%d TRACE_VAR %s %d" % (abs_ts, id, flag_val))
@@ -326,6 +957,47 @@ def process_msgs_file(msgs_filename, fout_hdrs=None):
     return msg_info
 
 
+# -----------------------------------------------------------------------------
+# fillup a MsgInfo data structure from the message table that the C++ API
+# leaves in the ELF file, instead of from a msgs.txt file. EMB_LOG_REGISTRY
+# can be in any number of translation units, each leaving a copy of the
+# table, so records can repeat but must agree
+# -----------------------------------------------------------------------------
+def process_msgs_elf(elf_filename):
+    elf = ElfFile(elf_filename)
+    data = elf.section_data(EMB_LOG_MSGS_SECTION)
+    if data is None:
+        print(
+            f"ERROR: no {EMB_LOG_MSGS_SECTION} section in {elf_filename}",
+            file=sys.stderr,
+        )
+        sys.exit(1)
+
+    lines = dict()
+    for ofs in range(0, len(data), EMB_LOG_MSGS_RECORD_LEN):
+        rec = data[ofs : ofs + EMB_LOG_MSGS_RECORD_LEN]
+        line = rec[4:].split(b"\0")[0].decode("ascii")
+        if line == "":  # padding
+            continue
+        msg_idx = elf.unpack_u32(rec, 0)
+        if lines.setdefault(msg_idx, line) != line:
+            print(
+                f"ERROR: message id {msg_idx} registered as both "
+                f"'{lines[msg_idx]}' and '{line}'",
+                file=sys.stderr,
+            )
+            sys.exit(1)
+
+    if sorted(lines) != list(range(len(lines))):
+        print("ERROR: message ids are not consecutive", file=sys.stderr)
+        sys.exit(1)
+
+    msg_info = MsgInfo()
+    for msg_idx in range(len(lines)):
+        process_msg_fmt_line(msg_info, None, lines[msg_idx])
+    return msg_info
+
+
 # -----------------------------------------------------------------------------
 # main program
 # -----------------------------------------------------------------------------
@@ -346,6 +1018,12 @@ def main():
         default="msgs.txt",
         help="msg definition file",
     )
+    parser.add_argument(
+        "--msgs_from_elf",
+        action="store_true",
+        help="read the msg definitions from the --elf file (C++ API) "
+        "instead of --msgs",
+    )
     parser.add_argument(
         "--output_style",
         choices=["rpt", "vcd"],
@@ -358,12 +1036,57 @@ def main():
         default="/dev/stdout",
         help="output file name for reports",
     )
+    parser.add_argument(
+        "--out_folded",
+        type=str,
+        help="output file name for folded stacks of traced functions",
+    )
+    parser.add_argument(
+        "--elf",
+        help="ELF file of the traced application, to symbolize addresses",
+    )
     parser.add_argument(
         "--freq_in_mhz",
         default=1000.0,
         type=float,
         help="Frequency of timestamp ticks in MHz",
     )
+    parser.add_argument(
+        "--compensate",
+        action="store_true",
+        help="subtract the calibrated logging overhead from time deltas",
+    )
+    parser.add_argument(
+        "--id_bits",
+        default=EMB_LOG_ID_BITS_DEFAULT,
+        type=int,
+        help="bits of the id word used for the message id, "
+        "the time-stamp delta gets 30 - id_bits",
+    )
+    parser.add_argument(
+        "--ts_prescale",
+        default=0,
+        type=int,
+        help="time-stamps are logged as ts >> ts_prescale (0..31)",
+    )
+    parser.add_argument(
+        "--func_trace",
+        action="store_true",
+        help="the target is built with EMB_LOG_FUNC_TRACE, reserving the "
+        "last message id for function entry/exit",
+    )
+    parser.add_argument(
+        "--recommend_split",
+        action="store_true",
+        help="recommend --id_bits / --ts_prescale minimizing the words "
+        "needed by the messages in --hex_log",
+    )
+    parser.add_argument(
+        "--max_prescale",
+        default=0,
+        type=int,
+        help="max --ts_prescale considered by --recommend_split",
+    )
     parser.add_argument(
         "--dbg_level",
         default=1,
@@ -401,6 +1124,9 @@ def main():
         )
         exit(1)
 
+    set_encoding(args.id_bits, args.ts_prescale)
+    set_func_trace(args.func_trace)
+
     # if we need to generate c-header file
     if args.hdrs:
         print("Generating c-header file", file=sys.stderr)
@@ -423,29 +1149,119 @@ def main():
             emit("#else")
             emit("# define EMB_LOG_IF(lvl,x) do {} while(0)")
             emit("#endif\n")
+            emit("#define EMB_LOG_ID_BITS %d" % EMB_LOG_ID_BITS)
+            emit("#define EMB_LOG_TS_PRESCALE %d" % EMB_LOG_TS_PRESCALE)
             emit("#define EMB_LOG_TS_SHIFT %d" % EMB_LOG_TS_SHIFT)
             emit("#define EMB_LOG_TS64_BIT %d" % EMB_LOG_TS64_BIT)
             emit("#define EMB_LOG_TS64_MASK %d" % EMB_LOG_TS64_MASK)
             emit("#define EMB_LOG_FLAG_VAL_BIT %d" % EMB_LOG_FLAG_VAL_BIT)
-            emit("#define EMB_LOG_TS_MAX 0x%x\n" % EMB_LOG_TS_MAX)
-            emit("typedef uint32_t log_u32;\n")
+            emit("#define EMB_LOG_TS_MAX 0x%x" % EMB_LOG_TS_MAX)
+            emit("#define EMB_LOG_FUNC_ID 0x%x\n" % EMB_LOG_FUNC_ID)
+            emit("typedef uint32_t log_u32;")
+            emit("typedef int32_t log_str; // offset from emb_log_init()")
+            emit("typedef float log_f32;")
+            emit("typedef struct { uint32_t lo, hi; } log_f64;\n")
+            emit(
+                "#define EMB_LOG_STR(s) "
+                "((log_str)((intptr_t)(s) - (intptr_t)&emb_log_init))\n"
+            )
+            emit(
+                "static inline log_f64 emb_log_f64(double d) "
+                "__attribute__((no_instrument_function));"
+            )
+            emit("static inline log_f64 emb_log_f64(double d)")
+            emit("{")
+            emit("    union { double d; uint64_t u; } x;")
+            emit("    log_f64 w;")
+            emit("    x.d = d;")
+            emit("    w.lo = (uint32_t)x.u;")
+            emit("    w.hi = (uint32_t)(x.u >> 32);")
+            emit("    return w;")
+            emit("}\n")
             msg_info = process_msgs_file(args.msgs, fout_hdrs)
-    else:
-        msg_info = process_msgs_file(args.msgs)
+
+            # channel table, X(name, entries, one_shot, start_after,
+            # stop_after), the index of each channel is its position in it
+            emit("#define EMB_LOG_CHANNELS(X) \\")
+            for name, cfg in msg_info.chans.items():
+                emit(
+                    "    X(%s, %s, %d, %d, %d) \\"
+                    % (
+                        name,
+                        cfg["entries"],
+                        cfg["one_shot"],
+                        cfg["start_after"],
+                        cfg["stop_after"],
+                    )
+                )
+            emit("")
+            for idx, name in enumerate(msg_info.chans):
+                emit("#define EMB_LOG_CHAN_%s %d" % (name.upper(), idx))
+            emit("#define EMB_LOG_NUM_CHANS %d" % len(msg_info.chans))
+            emit("#define EMB_LOG_NUM_MSGS %d" % len(msg_info.dec_lst))
 
     # if there is an input log to process
     if args.hex_log:
         print("Processing log file", args.hex_log, file=sys.stderr)
-        hex_dump = capture_hex_buffer(args.hex_log)
+        header, chans = capture_hex_buffer(args.hex_log)
+
+        # the dump carries the encoding the target was built with, which
+        # is needed before reading the messages (e.g. range of ids)
+        if "id_bits" in header:
+            set_encoding(int(header["id_bits"]), int(header["ts_prescale"]))
+        if "func_trace" in header:
+            set_func_trace(header["func_trace"] == "1")
+
+        if args.msgs_from_elf:
+            if args.elf is None:
+                print(
+                    "ERROR: --msgs_from_elf requires --elf", file=sys.stderr
+                )
+                exit(1)
+            msg_info = process_msgs_elf(args.elf)
+        else:
+            msg_info = process_msgs_file(args.msgs)
+
+        if args.recommend_split:
+            recommend_split(msg_info, chans, args.max_prescale, args.out_rpt)
+            return
+
+        formated = merge_channels(msg_info, chans)
+        symb = Symbolizer(args.elf)
+
+        # account for the logging overhead if it was calibrated
+        ovh_summary = None
+        if "overhead_ticks" in header:
+            overhead_ticks = [
+                int(x) for x in header["overhead_ticks"].split(",")
+            ]
+            ovh = logging_overhead(formated, overhead_ticks)
+            span, span_ovh = common_span_overhead(formated, ovh, chans)
+            ovh_summary = (span, span_ovh, args.compensate)
+            if args.compensate:
+                for msg, ovh_ticks in zip(formated, ovh):
+                    msg[0] -= ovh_ticks
 
         # dump report depending on output style
         if args.output_style == "rpt":
-            dump_human_rpt(msg_info, hex_dump, args.freq_in_mhz, args.out_rpt)
+            dump_human_rpt(
+                msg_info,
+                formated,
+                symb,
+                args.freq_in_mhz,
+                ovh_summary,
+                chans,
+                header,
+                args.out_rpt,
+            )
         else:
             dump_internal_trace(
-                msg_info, hex_dump, args.freq_in_mhz, args.out_rpt
+                msg_info, formated, symb, args.freq_in_mhz, args.out_rpt
             )
 
+        if args.out_folded:
+            dump_folded_stacks(formated, symb, args.out_folded)
+
 
 if __name__ == "__main__":
     main()
@@ -0,0 +1,208 @@
+#!/usr/bin/env python3
+# -----------------------------------------------------------------------------
+# MIT License
+#
+# Copyright 2022-Present Miguel A. Guerrero
+#
+# Permission is hereby granted, free of charge, to any person obtaining a
+# copy of this software and associated documentation files (the "Software"),
+# to deal # in the Software without restriction, including without limitation
+# the rights to use, copy, modify, merge, publish, distribute, sublicense,
+# and/or sell copies of the Software, and to permit persons to whom the
+# Software is furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included
+# in all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+# THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+# IN THE SOFTWARE.
+# -----------------------------------------------------------------------------
+# Runs the stress harness (stress/main.c) built with each locking mode for an
+# increasing number of producer threads, decodes every dump with gen_log.py
+# and checks that:
+#   - every message attempted was captured and decodes (nothing skipped)
+#   - the sequence numbers of each thread come out in order with no gaps
+# It reports the resulting events/sec as a scaling curve per mode, along with
+# how many times the producer changes along the timeline (switches, a measure
+# of how much they interleaved). Lock-free modes are required to scale
+# (--min_speedup) when there are enough cpus
+# -----------------------------------------------------------------------------
+import os
+import sys
+import argparse
+import subprocess
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), "..", "scripts"))
+import gen_log  # noqa: E402
+
+# modes whose throughput is expected to grow with the number of producers
+LOCK_FREE_MODES = {"percpu"}
+
+
+# -----------------------------------------------------------------------------
+# Decode one run and check it. Returns its events/sec, switches and a list of
+# errors (empty if all good)
+# -----------------------------------------------------------------------------
+def check_run(msgs, log_file):
+    header, chans = gen_log.capture_hex_buffer(log_file)
+    gen_log.set_encoding(int(header["id_bits"]), int(header["ts_prescale"]))
+    msg_info = gen_log.process_msgs_file(msgs)
+    formated = gen_log.merge_channels(msg_info, chans)
+
+    threads = int(header["threads"])
+    msgs_per_thread = int(header["msgs_per_thread"])
+    errors = []
+
+    for name, chan in chans.items():
+        hdr, stats = chan["header"], chan["stats"]
+        attempted, captured = int(hdr["evnt_cnt"]), int(hdr["captured"])
+        if captured != attempted:
+            errors.append(
+                f"{name}: {attempted - captured} of {attempted} messages "
+                "dropped"
+            )
+        if stats["skipped_words"] or stats["decoded"] != captured:
+            errors.append(
+                f"{name}: {stats['decoded']} of {captured} messages decoded, "
+                f"{stats['skipped_words']} words skipped"
+            )
+
+    next_n = [0] * threads
+    switches = 0
+    prev_thread = None
+    for delta_ts, id, flag_val, xargs in formated:
+        args = {name: val for name, _, val in xargs}
+        thread, n = args["thread"], args["n"]
+        switches += prev_thread is not None and thread != prev_thread
+        prev_thread = thread
+        if thread >= threads or n != next_n[thread]:
+            errors.append(
+                f"thread {thread}: got n={n}, expected "
+                f"{next_n[thread] if thread < threads else '-'}"
+            )
+            break
+        next_n[thread] += 1
+    for thread, n in enumerate(next_n):
+        if n != msgs_per_thread:
+            errors.append(
+                f"thread {thread}: {n} of {msgs_per_thread} messages found"
+            )
+
+    events = threads * msgs_per_thread
+    rate = events / (int(header["elapsed_ns"]) * 1e-9)
+    return rate, switches, errors
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        "check_stress.py",
+        formatter_class=argparse.ArgumentDefaultsHelpFormatter,
+    )
+    parser.add_argument(
+        "bins",
+        nargs="+",
+        help="harness binaries, one per mode, named after it",
+    )
+    parser.add_argument(
+        "--msgs",
+        default=os.path.join(os.path.dirname(__file__), "msgs.txt"),
+        help="msg definition file the harness was built with",
+    )
+    parser.add_argument(
+        "--threads",
+        default="1,2,4,8",
+        help="comma separated list of producer thread counts",
+    )
+    parser.add_argument(
+        "--msgs_per_thread",
+        default=10000,
+        type=int,
+        help="messages logged by each thread",
+    )
+    parser.add_argument(
+        "--yield_every",
+        default=0,
+        type=int,
+        help="producers yield the cpu every so many messages (0: never), "
+        "to interleave them with fewer cpus than threads",
+    )
+    parser.add_argument(
+        "--min_speedup",
+        default=1.2,
+        type=float,
+        help="min events/sec gain of lock-free modes from 1 to "
+        "min(cpus, max threads) threads",
+    )
+    parser.add_argument(
+        "--rundir",
+        default="rundir",
+        help="directory for the dumps of each run",
+    )
+    args = parser.parse_args()
+
+    thread_counts = [int(t) for t in args.threads.split(",")]
+    cpus = os.cpu_count() or 1
+    os.makedirs(args.rundir, exist_ok=True)
+    failed = False
+
+    print(f"{cpus} cpus, {args.msgs_per_thread} messages per thread")
+    print("mode      threads    events/sec   speedup  switches  check")
+    for bin_file in args.bins:
+        mode = os.path.basename(bin_file)
+        rates = dict()
+        for threads in thread_counts:
+            log_file = os.path.join(
+                args.rundir, f"stress_{mode}_{threads}.log"
+            )
+            with open(log_file, "w") as fout:
+                subprocess.run(
+                    [
+                        bin_file,
+                        str(threads),
+                        str(args.msgs_per_thread),
+                        str(args.yield_every),
+                    ],
+                    stdout=fout,
+                    check=True,
+                )
+            rate, switches, errors = check_run(args.msgs, log_file)
+            rates[threads] = rate
+            print(
+                "%-8s %8d  %12.0f  %8.2f  %8d  %s"
+                % (
+                    mode,
+                    threads,
+                    rate,
+                    rate / rates[thread_counts[0]],
+                    switches,
+                    "ok" if not errors else "FAIL",
+                )
+            )
+            for e in errors:
+                print(f"    {e}")
+            failed |= bool(errors)
+
+        # scaling can only be expected with cpus to run the producers on
+        scaled = max([t for t in thread_counts if t <= cpus], default=1)
+        if mode in LOCK_FREE_MODES and scaled > thread_counts[0]:
+            speedup = rates[scaled] / rates[thread_counts[0]]
+            if speedup < args.min_speedup:
+                print(
+                    f"    {mode} doesn't scale: {speedup:.2f}x with "
+                    f"{scaled} threads, expected {args.min_speedup:.2f}x"
+                )
+                failed = True
+        elif mode in LOCK_FREE_MODES:
+            print(f"    {mode} scaling not checked, {cpus} cpu(s)")
+
+    print("FAIL" if failed else "PASS")
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,127 @@
+//--------------------------------------------------------------------------
+// Multi-threaded stress harness. Starts N producer threads that log M
+// messages each as fast as they can, carrying the thread number and a
+// sequence number, reports the time it took and dumps the log for
+// check_stress.py to verify. Built once per locking mode:
+//
+//   -DEMB_LOG_LOCK_SPIN      all threads log into main under a spin lock
+//   -DEMB_LOG_LOCK_MUTEX     all threads log into main under a mutex
+//   -DSTRESS_PER_THREAD_CHAN each thread logs into its own channel, no lock
+//
+// usage: main [threads] [msgs_per_thread] [yield_every]
+//
+// yield_every (0 to never) makes the producers yield the cpu every so many
+// messages, to get them to interleave on hosts with fewer cpus than threads
+//--------------------------------------------------------------------------
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "emb_log.h"
+#include "msgs_auto.h"
+
+#define MAX_THREADS 8
+
+static int msgs_per_thread = 10000;
+static int yield_every = 0;
+static pthread_barrier_t start_barrier;
+static int64_t start_ns[MAX_THREADS], end_ns[MAX_THREADS];
+
+static int64_t now_ns()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+#if defined(STRESS_PER_THREAD_CHAN)
+typedef void (*log_seq_f)(uint32_t thread, uint32_t n);
+
+#define STRESS_LOG_SEQ(t) \
+    static void log_seq##t(uint32_t thread, uint32_t n) \
+    { EMB_LOG_SEQ##t(thread, n); }
+STRESS_LOG_SEQ(0) STRESS_LOG_SEQ(1) STRESS_LOG_SEQ(2) STRESS_LOG_SEQ(3)
+STRESS_LOG_SEQ(4) STRESS_LOG_SEQ(5) STRESS_LOG_SEQ(6) STRESS_LOG_SEQ(7)
+
+static const log_seq_f log_seq_by_thread[MAX_THREADS] = {
+    log_seq0, log_seq1, log_seq2, log_seq3,
+    log_seq4, log_seq5, log_seq6, log_seq7,
+};
+#endif
+
+static void *producer(void *arg)
+{
+    uint32_t thread = (uint32_t)(intptr_t)arg;
+    uint32_t n;
+#if defined(STRESS_PER_THREAD_CHAN)
+    log_seq_f log_seq = log_seq_by_thread[thread];
+#endif
+
+    pthread_barrier_wait(&start_barrier); // all threads start at once
+    start_ns[thread] = now_ns();
+    for (n = 0; n < (uint32_t)msgs_per_thread; n++) {
+#if defined(STRESS_PER_THREAD_CHAN)
+        log_seq(thread, n);
+#else
+        EMB_LOG_SEQ(thread, n);
+#endif
+        if (yield_every && n % yield_every == 0) {
+            sched_yield();
+        }
+    }
+    end_ns[thread] = now_ns();
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    pthread_t tids[MAX_THREADS];
+    int64_t t0, t1;
+    int threads = 4;
+    int i;
+
+    if (argc > 1) {
+        threads = atoi(argv[1]);
+    }
+    if (argc > 2) {
+        msgs_per_thread = atoi(argv[2]);
+    }
+    if (argc > 3) {
+        yield_every = atoi(argv[3]);
+    }
+    if (threads < 1 || threads > MAX_THREADS || msgs_per_thread < 1) {
+        fprintf(stderr, "usage: %s [1..%d threads] [msgs_per_thread] "
+                "[yield_every]\n",
+                argv[0], MAX_THREADS);
+        return 1;
+    }
+
+    emb_log_init();
+    emb_log_set_enable(1);
+
+    pthread_barrier_init(&start_barrier, NULL, threads + 1);
+    for (i = 0; i < threads; i++) {
+        pthread_create(&tids[i], NULL, producer, (void *)(intptr_t)i);
+    }
+    pthread_barrier_wait(&start_barrier);
+    for (i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+
+    // from the first thread starting to the last one finishing
+    t0 = start_ns[0];
+    t1 = end_ns[0];
+    for (i = 1; i < threads; i++) {
+        t0 = start_ns[i] < t0 ? start_ns[i] : t0;
+        t1 = end_ns[i] > t1 ? end_ns[i] : t1;
+    }
+
+    printf("threads=%d\n", threads);
+    printf("msgs_per_thread=%d\n", msgs_per_thread);
+    printf("elapsed_ns=%lld\n", (long long)(t1 - t0));
+    fflush(stdout);
+    emb_log_dump(0);
+
+    return 0;
+}